@@ -0,0 +1,158 @@
+#ifndef BUS_FORMAT_H
+#define BUS_FORMAT_H
+
+#include "TelemetryFormat.h"
+
+// Cell bus format, shared by the firmware and the host dispatcher.
+//
+// The sorting cells along a line and the host share one half-duplex serial
+// line (RS-485, or a plain UART for a single cell). Before framing, a
+// message is
+//
+//   offset  size  field
+//        0     1  destination address
+//        1     1  source address
+//        2     1  command (BusCommand)
+//        3     n  payload, layout per command below
+//      3+n     2  CRC-16/CCITT-FALSE of bytes 0..2+n
+//
+// and is framed like telemetry: COBS-encoded, then a single 0x00 delimiter.
+// All multi-byte fields are little-endian.
+//
+// Only the host starts an exchange. A cell answers a request addressed to
+// it within BUS_REPLY_TIMEOUT_MS and never answers a broadcast, so no two
+// nodes ever talk at once.
+const uint8_t BUS_HOST = 0;
+const uint8_t BUS_BROADCAST = 0xFF;
+const uint8_t BUS_HEADER_SIZE = 3;
+const uint8_t BUS_MAX_PAYLOAD = 16;
+const uint8_t BUS_MAX_MESSAGE = BUS_HEADER_SIZE + BUS_MAX_PAYLOAD + TELEMETRY_CRC_SIZE;
+const uint8_t BUS_MAX_FRAME = BUS_MAX_MESSAGE + 1 + 1;
+const unsigned long BUS_BAUD = 115200;
+
+// A cell can be in the middle of a color sensor pulse (up to ~14 ms) when a
+// request arrives
+const uint8_t BUS_REPLY_TIMEOUT_MS = 50;
+
+// An unanswered BUS_ASSIGN is sent again, with the same sequence number,
+// this many more times. The cell may have queued the object and only its
+// BUS_ACK was lost, so a cell that gets the sequence and color it has just
+// acknowledged, within BUS_REPEAT_WINDOW_MS, sends the same BUS_ACK again
+// and queues nothing.
+const uint8_t BUS_ASSIGN_RETRIES = 3;
+const unsigned int BUS_REPEAT_WINDOW_MS = 1000;
+
+enum BusCommand : uint8_t
+{
+  // Host to cell
+  BUS_POLL = 0x01,   // (none); answered with BUS_STATUS
+  BUS_ASSIGN = 0x02, // u8 sequence, u8 Color, u16 ms until it reaches the cell's pick
+                     // position; answered with BUS_ACK
+
+  // Cell to host
+  BUS_STATUS = 0x81, // u8 arms, u8 objects queued, u8 room for more, u32 objects sorted,
+                     // u16 last cycle ms, u16 objects dropped
+  BUS_ACK = 0x82     // u8 sequence, u8 arm it went to, BUS_REJECTED if none had room
+};
+
+const uint8_t BUS_REJECTED = 0xFF;
+
+struct BusMessage
+{
+  uint8_t destination;
+  uint8_t source;
+  uint8_t command;
+  const uint8_t *payload;
+  uint8_t payloadLength;
+};
+
+// Build the frame for one message, delimiter included, into frame (room for
+// BUS_MAX_FRAME). Returns its length, or 0 if the payload is too long.
+inline size_t busEncode(uint8_t destination, uint8_t source, uint8_t command, const uint8_t *payload,
+                        uint8_t length, uint8_t *frame)
+{
+  if (length > BUS_MAX_PAYLOAD)
+  {
+    return 0;
+  }
+
+  uint8_t message[BUS_MAX_MESSAGE];
+  message[0] = destination;
+  message[1] = source;
+  message[2] = command;
+  for (uint8_t i = 0; i < length; i++)
+  {
+    message[BUS_HEADER_SIZE + i] = payload[i];
+  }
+  uint8_t body = BUS_HEADER_SIZE + length;
+  uint16_t crc = telemetryCrc16(message, body);
+  message[body] = (uint8_t)crc;
+  message[body + 1] = (uint8_t)(crc >> 8);
+
+  size_t frameLength = cobsEncode(message, body + TELEMETRY_CRC_SIZE, frame);
+  frame[frameLength++] = 0;
+  return frameLength;
+}
+
+// Collects bytes off the line into messages. Everything up to the next
+// delimiter after a bad or oversized frame is thrown away and counted.
+struct BusReceiver
+{
+  BusReceiver() : length(0), overflow(false), badFrames(0) {}
+
+  // Add one byte. Returns true when it completes a valid message; out then
+  // points into the receiver until the next call.
+  bool push(uint8_t byte, BusMessage &out)
+  {
+    if (byte != 0)
+    {
+      if (length == BUS_MAX_FRAME)
+      {
+        overflow = true;
+      }
+      else
+      {
+        frame[length++] = byte;
+      }
+      return false;
+    }
+
+    uint8_t frameLength = length;
+    bool tooLong = overflow;
+    length = 0;
+    overflow = false;
+    if (frameLength == 0)
+    {
+      return false;
+    }
+
+    size_t messageLength = tooLong ? 0 : cobsDecode(frame, frameLength, message);
+    if (messageLength < BUS_HEADER_SIZE + TELEMETRY_CRC_SIZE || messageLength > BUS_MAX_MESSAGE)
+    {
+      badFrames++;
+      return false;
+    }
+    size_t body = messageLength - TELEMETRY_CRC_SIZE;
+    uint16_t crc = (uint16_t)(message[body] | (message[body + 1] << 8));
+    if (crc != telemetryCrc16(message, body))
+    {
+      badFrames++;
+      return false;
+    }
+
+    out.destination = message[0];
+    out.source = message[1];
+    out.command = message[2];
+    out.payload = message + BUS_HEADER_SIZE;
+    out.payloadLength = (uint8_t)(body - BUS_HEADER_SIZE);
+    return true;
+  }
+
+  uint8_t frame[BUS_MAX_FRAME];
+  uint8_t message[BUS_MAX_FRAME];
+  uint8_t length;
+  bool overflow;
+  unsigned long badFrames;
+};
+
+#endif
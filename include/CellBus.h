@@ -0,0 +1,49 @@
+#ifndef CELL_BUS_H
+#define CELL_BUS_H
+
+#include <Arduino.h>
+#include "BusFormat.h"
+
+// No RS-485 driver enable pin: the transmitter is always on (plain UART)
+const uint8_t BUS_NO_ENABLE_PIN = 0xFF;
+
+// Answers a request addressed to this cell. Gets the command and its
+// payload, fills in the reply (room for BUS_MAX_PAYLOAD bytes) and returns
+// its length; sets replyCommand to 0 to send nothing back.
+typedef uint8_t (*BusHandler)(uint8_t command, const uint8_t *payload, uint8_t length, uint8_t *reply,
+                              uint8_t &replyCommand);
+
+// This cell's end of the cell bus (see BusFormat.h for the wire format).
+//
+// update() only consumes what has already arrived and only queues the
+// reply in the serial TX buffer, so it never blocks. With an RS-485
+// transceiver the driver is switched on for the reply and back off by a
+// later update() once the last byte has had time to leave the UART.
+class CellBus
+{
+public:
+  CellBus();
+
+  void begin(HardwareSerial &serialPort, uint8_t address, uint8_t enablePin = BUS_NO_ENABLE_PIN);
+  void setHandler(BusHandler handler) { requestHandler = handler; }
+
+  void update();
+
+  // Requests answered, and frames that were corrupt
+  void print(Print &out) const;
+
+private:
+  void reply(uint8_t command, const uint8_t *payload, uint8_t length);
+
+  HardwareSerial *port;
+  uint8_t ownAddress;
+  uint8_t driverPin;
+  BusHandler requestHandler;
+  BusReceiver receiver;
+  bool driving;
+  unsigned long driveStartUs;
+  unsigned long driveUs;
+  unsigned long requests;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <Arduino.h>
+#include "TelemetryFormat.h"
+
+// Slots in the EEPROM ring. Each checkpoint goes to the next slot, so a
+// cell is rewritten once every CHECKPOINT_SLOTS checkpoints: at about
+// twenty per cycle (one per move) that is nearly two years of continuous
+// sorting before the 100,000-write endurance runs out. Arms sharing the
+// EEPROM split it, each with its own smaller ring.
+const uint8_t CHECKPOINT_SLOTS = 255;
+
+// The ring always starts here, clear of the saved parameters (see
+// CommandShell.h), so adding a parameter doesn't move it. 255 slots take
+// 3060 of the Mega's 4096 bytes.
+const int CHECKPOINT_EEPROM_ADDRESS = 1024;
+
+// First byte of every slot. Change it whenever the record layout changes,
+// so records written by an older build are ignored.
+const uint8_t CHECKPOINT_LAYOUT = 0xC1;
+
+// The arm as it was at the last state change
+struct CheckpointRecord
+{
+  uint16_t sequence;           // Counts up with every checkpoint
+  uint8_t phase;               // TelemetryState entered
+  uint8_t color;               // Color being carried, COLOR_NONE if none
+  uint8_t angles[SERVO_COUNT]; // Last commanded angle of every joint
+};
+
+// Layout byte, the record, then a CRC-16 (see TelemetryFormat.h)
+const uint8_t CHECKPOINT_RECORD_SIZE = 1 + 4 + SERVO_COUNT + 2;
+
+#ifdef E2END
+static_assert(CHECKPOINT_EEPROM_ADDRESS + (long)CHECKPOINT_SLOTS * CHECKPOINT_RECORD_SIZE <= E2END + 1L,
+              "checkpoint ring doesn't fit in EEPROM");
+#endif
+
+// Wear-levelled checkpoint of the pose and cycle phase in EEPROM.
+//
+// begin() scans the ring for the newest valid slot. save() only stages a
+// record; update() writes it one byte per call, and only when the EEPROM
+// has finished the previous byte, so a checkpoint never holds up the
+// motion. The CRC goes last, so a slot cut short by a reset is simply
+// invalid and the one before it is used. The CRC also covers where the
+// ring is and how many slots it has, so a record left behind by a build
+// that split the EEPROM differently (another ARM_COUNT) is never taken
+// for one of this ring's.
+class Checkpoint
+{
+public:
+  Checkpoint();
+
+  // Returns true if a valid checkpoint was found in the ring of slotCount
+  // slots at address
+  bool begin(int address, uint8_t slotCount = CHECKPOINT_SLOTS);
+
+  bool valid() const { return found; }
+  const CheckpointRecord &last() const { return newest; }
+
+  // Stage a record. One the same as the newest is dropped, and a newer one
+  // replaces one that hasn't started writing yet.
+  void save(uint8_t phase, uint8_t color, const uint8_t angles[SERVO_COUNT]);
+
+  // Write the next byte of a staged checkpoint, if the EEPROM is ready
+  void update();
+  bool busy() const { return writing || staged; }
+
+  static uint16_t eepromSize(uint8_t slotCount = CHECKPOINT_SLOTS)
+  {
+    return (uint16_t)slotCount * CHECKPOINT_RECORD_SIZE;
+  }
+
+private:
+  uint16_t crc(const uint8_t *bytes) const;
+  void pack(const CheckpointRecord &record, uint8_t *out) const;
+  bool readSlot(uint8_t slot, CheckpointRecord &record) const;
+
+  int baseAddress;
+  uint8_t slots;
+  bool found;
+  CheckpointRecord newest;
+  uint8_t nextSlot;
+
+  CheckpointRecord pending;
+  bool staged;
+  uint8_t bytes[CHECKPOINT_RECORD_SIZE];
+  uint8_t writeIndex;
+  int writeAddress;
+  bool writing;
+};
+
+#endif
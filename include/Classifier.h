@@ -0,0 +1,34 @@
+#ifndef CLASSIFIER_H
+#define CLASSIFIER_H
+
+#include "Color.h"
+
+// Valid color readings (0.1us pulse width at 20% scaling, was 0-116us)
+const uint16_t CLASSIFIER_MIN_VALID = 0;
+const uint16_t CLASSIFIER_MAX_VALID = 1160;
+
+// A channel has to be below this fraction of the other valid ones to win
+const float CLASSIFIER_DOMINANCE = 0.9f;
+
+// classifyLowest() only accepts a channel whose pulse is shorter than this
+// (was 50us in the color-only sketch)
+const uint16_t CLASSIFIER_LOWEST_LIMIT = 500;
+
+struct Classification
+{
+  Color color;  // Dominant color, COLOR_UNKNOWN if ambiguous, COLOR_NONE if nothing valid
+  Color lowest; // Valid channel with the shortest pulse, COLOR_NONE if nothing valid
+  bool validRed;
+  bool validGreen;
+  bool validBlue;
+};
+
+// Classify one reading. Pure function with no Arduino dependencies, so the
+// trace replay tool can run the same code on the host.
+Classification classifyColor(const ColorReading &reading);
+
+// The color-only sketch's rule: the shortest pulse wins if it is strictly
+// shorter than the other two and below limit, however close they are
+Classification classifyLowest(const ColorReading &reading, uint16_t limit);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef COLOR_H
+#define COLOR_H
+
+#include <stdint.h>
+
+// Only needs to build without Arduino.h, so the classifier can also be
+// compiled into host tools
+class __FlashStringHelper;
+
+// Object colors the sorter knows about. Kept to one byte so it can go
+// straight into logs and EEPROM.
+enum Color : uint8_t
+{
+  COLOR_UNKNOWN,
+  COLOR_RED,
+  COLOR_GREEN,
+  COLOR_BLUE,
+  COLOR_NONE
+};
+
+// One raw sensor reading: LOW pulse widths in 0.1us at 20% scaling (see
+// ColorSensor.h). Shorter means more of that color.
+struct ColorReading
+{
+  uint16_t red;
+  uint16_t green;
+  uint16_t blue;
+};
+
+// Lower-case name of a color, stored in flash. Print it with Serial.print().
+const __FlashStringHelper *colorName(Color color);
+
+#endif
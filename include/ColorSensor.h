@@ -0,0 +1,97 @@
+#ifndef COLOR_SENSOR_H
+#define COLOR_SENSOR_H
+
+#include <Arduino.h>
+#include "Color.h"
+
+// TCS3200 output frequency scaling, selected through S0/S1
+enum SensorScale
+{
+  SCALE_2_PERCENT,
+  SCALE_20_PERCENT,
+  SCALE_100_PERCENT
+};
+
+// Photodiode group selected through S2/S3
+enum SensorChannel
+{
+  CHANNEL_RED,
+  CHANNEL_GREEN,
+  CHANNEL_BLUE,
+  CHANNEL_CLEAR
+};
+
+// Outcome of a sensor read. A timeout is not a reading: the values are left
+// untouched and must not be classified.
+enum SensorStatus
+{
+  SENSOR_OK,
+  SENSOR_TIMEOUT
+};
+
+// Readings are the LOW pulse width the sensor would give at 20% scaling, in
+// tenths of a microsecond, whatever scaling was actually used to take them.
+// This keeps the classifier thresholds the same across ranges.
+const unsigned int SENSOR_READING_MAX = 65535;
+
+// Auto-ranging picks the fastest scaling whose shortest pulse still has at
+// least this many microseconds of resolution...
+const unsigned int SENSOR_MIN_COUNTS = 20;
+// ...and whose longest expected pulse fits in the per-reading time budget
+const unsigned long SENSOR_READ_BUDGET_US = 2000;
+
+// Time the photodiode output needs to settle after switching filters
+const unsigned long SENSOR_SETTLE_MS = 150;
+
+// Shortest deadline a three-channel reading can meet. The deadline is
+// checked before blue, which comes after two filter settles and two pulse
+// waits; at 2% scaling channelTimeoutUs() is 3 * slowestReading + 100.
+constexpr unsigned long sensorMinDeadlineMs(unsigned int slowestReading)
+{
+  return 2 * SENSOR_SETTLE_MS + 2 * (((unsigned long)slowestReading * 3 + 100 + 999) / 1000);
+}
+
+class ColorSensor
+{
+public:
+  ColorSensor(uint8_t s0Pin, uint8_t s1Pin, uint8_t s2Pin, uint8_t s3Pin, uint8_t outPin);
+
+  // Configure the pins and start at 20% scaling. slowestReading is the
+  // longest pulse (same units as the readings) still worth waiting for; the
+  // per-channel pulseIn timeout is derived from it for the active range.
+  void begin(bool autoRange, unsigned int slowestReading);
+
+  // A reading is spread over several calls: select() a channel, wait until
+  // settled(), then sample() it (which still waits for one pulse, bounded
+  // by channelTimeoutUs()). Report the outcome of a full reading with
+  // finishReading() so auto-ranging can pick the next range.
+  void select(SensorChannel channel);
+  bool settled() const;
+  SensorStatus sample(uint16_t &value) { return measure(value); }
+  void finishReading(SensorStatus status, const ColorReading &reading);
+
+  SensorScale scale() const { return currentScale; }
+  uint8_t scalePercent() const;
+
+  // pulseIn timeout used for one channel at the current range
+  unsigned long channelTimeoutUs() const;
+
+private:
+  void selectFilter(uint8_t s2Level, uint8_t s3Level);
+  SensorStatus measure(uint16_t &value);
+  void adjustRange(unsigned int shortest, unsigned int longest);
+  void applyScale(SensorScale newScale);
+  static uint8_t percentFor(SensorScale s);
+
+  uint8_t s0;
+  uint8_t s1;
+  uint8_t s2;
+  uint8_t s3;
+  uint8_t out;
+  bool autoRanging;
+  unsigned int slowest;
+  SensorScale currentScale;
+  unsigned long selectedAtMs;
+};
+
+#endif
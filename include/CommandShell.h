@@ -0,0 +1,75 @@
+#ifndef COMMAND_SHELL_H
+#define COMMAND_SHELL_H
+
+#include <Arduino.h>
+
+// A named runtime parameter. Tables of these live in PROGMEM; value points
+// at the global the firmware actually uses.
+struct ParamInfo
+{
+  char name[20];
+  int *value;
+  int minValue;
+  int maxValue;
+};
+
+// Saved parameters start here in EEPROM: magic, count, values, checksum
+const int PARAMS_EEPROM_ADDRESS = 0;
+const uint16_t PARAMS_EEPROM_MAGIC = 0x5041; // "AP"
+
+// Handler for commands the shell doesn't know itself. Gets the command word
+// and the rest of the line; returns false if it doesn't know it either.
+typedef bool (*CommandHandler)(const char *command, char *args, Print &out);
+
+// Non-blocking line-based command interface for tuning on the line:
+//
+//   get [name]          show one parameter, or all of them
+//   set name value      change a parameter (range checked)
+//   save                store all parameters in EEPROM
+//   load                reload them from EEPROM
+//
+// poll() only consumes what has already arrived, so it can be called from
+// yield() between motion steps. save only stages the write; update() then
+// writes one changed byte per call, and only once the EEPROM has finished
+// the last one, so saving never holds up the motion.
+class CommandShell
+{
+public:
+  CommandShell(Stream &input, Print &output, const ParamInfo *params, uint8_t paramCount);
+
+  void setHandler(CommandHandler handler) { extraCommands = handler; }
+
+  void poll();
+
+  // Restore saved parameters; leaves the defaults alone if nothing valid
+  // has been saved for this parameter table
+  bool load();
+  void save();
+
+  // Write the next byte of a staged save, if the EEPROM is ready
+  void update();
+
+  uint16_t eepromSize() const;
+
+private:
+  void execute(char *line);
+  int find(const char *name) const;
+  void printParam(uint8_t index);
+  void readParam(uint8_t index, ParamInfo &info) const;
+  uint8_t savedByte(uint16_t offset) const;
+
+  Stream &in;
+  Print &out;
+  const ParamInfo *table;
+  uint8_t count;
+  CommandHandler extraCommands;
+  char line[48];
+  uint8_t length;
+  bool busy;
+
+  bool savePending;
+  uint16_t saveOffset; // Next byte to write
+  uint8_t saveSum;     // Of the parameter bytes written so far
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <Arduino.h>
+#include "TelemetryFormat.h"
+
+// Number of events kept; a full pick-and-release cycle logs about 60
+const uint8_t EVENT_LOG_SIZE = 96;
+const uint16_t EVENT_LOG_MAGIC = 0x4C45; // "EL"
+
+// One logged event: the telemetry event id, when it happened and the first
+// bytes of its payload (enough for steps, servo ids and angles, attempts and
+// the sense result and color)
+struct EventLogEntry
+{
+  uint32_t timeUs;
+  uint8_t event;
+  uint8_t data[3];
+};
+
+// Post-mortem event log. The last EVENT_LOG_SIZE telemetry events are kept
+// in RAM, and the one instance is placed in .noinit so a watchdog or reset
+// button restart leaves them in place to be dumped afterwards.
+//
+// There is deliberately no constructor: anything that ran at startup would
+// wipe what survived. begin() decides whether the contents are still valid.
+class EventLog
+{
+public:
+  // Keep the surviving entries if the header checks out, otherwise start
+  // empty, then log an EV_BOOT entry carrying resetCause (MCUSR)
+  void begin(uint8_t resetCause);
+
+  void clear();
+
+  // Log one telemetry event. Text, trace records, stats and dwells are
+  // skipped to leave room for the events worth having after a crash.
+  void record(TelemetryEvent event, uint32_t timeUs, const uint8_t *payload, uint8_t length);
+
+  uint8_t count() const { return used; }
+  uint16_t boots() const { return bootCount; }
+
+  // Entry index, oldest first
+  const EventLogEntry &entry(uint8_t index) const;
+
+  void printEntry(Print &out, uint8_t index) const;
+
+private:
+  uint16_t magic;
+  uint16_t bootCount;
+  uint8_t next;
+  uint8_t used;
+  EventLogEntry entries[EVENT_LOG_SIZE];
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef FEED_QUEUE_H
+#define FEED_QUEUE_H
+
+#include <Arduino.h>
+#include "Color.h"
+
+// Objects that can be on the feed between the sensor and the pick position
+const uint8_t FEED_QUEUE_SIZE = 8;
+
+// One object classified upstream
+struct FeedObject
+{
+  Color color;
+  unsigned long sensedMs;  // millis() when it was read
+  unsigned long arrivalMs; // millis() when it should reach the pick position
+};
+
+// FIFO of objects classified by a color sensor upstream on the feed. The
+// feed keeps them in order, so the oldest entry is always the next object
+// the arm will find at the pick position.
+class FeedQueue
+{
+public:
+  FeedQueue();
+
+  // Queue an object that takes travelMs to reach the pick position.
+  // Returns false (and counts it) if the queue is full.
+  bool push(Color color, unsigned long sensedMs, unsigned long travelMs);
+
+  bool empty() const { return used == 0; }
+  uint8_t count() const { return used; }
+
+  // Oldest object; only valid when not empty()
+  const FeedObject &front() const { return entries[head]; }
+
+  // Milliseconds until the oldest object reaches the pick position, 0 if it
+  // already has
+  unsigned long msUntilArrival() const;
+
+  void pop();
+  void clear();
+
+  unsigned int dropped() const { return overflows; }
+
+  void print(Print &out) const;
+
+private:
+  FeedObject entries[FEED_QUEUE_SIZE];
+  uint8_t head;
+  uint8_t used;
+  unsigned int overflows;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef JOINT_LIMITS_H
+#define JOINT_LIMITS_H
+
+#include <stdint.h>
+#include "TelemetryFormat.h"
+
+// Safe travel of each joint (indexed by TelemetryServo), in degrees. Past
+// these the mechanism hits a hard stop: the servo stalls at full current
+// and can brown out the board.
+struct JointLimit
+{
+  int minAngle;
+  int maxAngle;
+};
+
+constexpr JointLimit JOINT_LIMITS[SERVO_COUNT] = {
+    {0, 180},  // Base: 0=forward, 90=left, 180=toward me
+    {0, 140},  // Arm: 0=left, 140=right for grabbing
+    {0, 90},   // Joint: 90=for picking, 0=for lifting
+    {90, 150}, // Grabber 1: 90=initial, 150=optimal position
+    {0, 70}};  // Grabber 2: 0-70 range as tested
+
+constexpr bool withinLimits(uint8_t joint, int angle)
+{
+  return angle >= JOINT_LIMITS[joint].minAngle && angle <= JOINT_LIMITS[joint].maxAngle;
+}
+
+// Bring a computed angle back inside the joint's travel
+inline int clampToLimits(uint8_t joint, int angle)
+{
+  const JointLimit &limit = JOINT_LIMITS[joint];
+  return angle < limit.minAngle ? limit.minAngle : angle > limit.maxAngle ? limit.maxAngle : angle;
+}
+
+// A pose known at compile time: Pose<SERVO_ARM, 140>::value is 140, and the
+// build fails if 140 is outside the arm's limits
+template <uint8_t Joint, int Angle>
+struct Pose
+{
+  static_assert(Joint < SERVO_COUNT, "no such joint");
+  static_assert(withinLimits(Joint, Angle), "pose outside the joint's limits");
+  static const int value = Angle;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+
+// Compile-time log levels. Set LOG_LEVEL from the build flags, e.g.
+// -DLOG_LEVEL=LOG_LEVEL_NONE for production; anything above it compiles to
+// nothing, arguments and strings included.
+enum LogLevel
+{
+  LOG_LEVEL_NONE,
+  LOG_LEVEL_ERROR,
+  LOG_LEVEL_WARN,
+  LOG_LEVEL_INFO,
+  LOG_LEVEL_DEBUG
+};
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+template <LogLevel Level>
+struct LogFilter
+{
+  static constexpr bool enabled = Level <= LOG_LEVEL;
+};
+
+// Where enabled messages go. Each LOG_* call prints one whole line.
+void logBegin(Print &out);
+Print *logOutput();
+
+inline void logPrint(Print &)
+{
+}
+
+template <typename T, typename... Rest>
+inline void logPrint(Print &out, const T &first, const Rest &...rest)
+{
+  out.print(first);
+  logPrint(out, rest...);
+}
+
+template <typename... Args>
+inline void logLine(const Args &...args)
+{
+  Print *out = logOutput();
+  if (out)
+  {
+    logPrint(*out, args...);
+    out->println();
+  }
+}
+
+// The filter is a constant, so a disabled call is dead code and is dropped
+// along with its arguments. Wrap string literals in F() so enabled messages
+// stay in flash.
+#define LOG_AT(level, ...)                 \
+  do                                       \
+  {                                        \
+    if (LogFilter<level>::enabled)         \
+    {                                      \
+      logLine(__VA_ARGS__);                \
+    }                                      \
+  } while (0)
+
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <Arduino.h>
+#include "ServoBackend.h"
+#include "Telemetry.h"
+
+// Snapshot of one joint, as reported by SortingArm::state()
+struct JointState
+{
+  int angle;    // Last commanded angle
+  int velocity; // Degrees per second, negative when the angle is falling
+  bool attached;
+};
+
+// Non-blocking servo motion. Each joint (indexed by TelemetryServo) steps one
+// degree every msPerDegree, so any number of joints can move at once while
+// the rest of the firmware keeps running. update() does the stepping and
+// must be called at least once per millisecond or so.
+//
+// Each joint remembers the angle it was last commanded to, and every move
+// starts from there, so nothing has to guess where a servo is. Timing
+// matches the old blocking moves: every degree is held for msPerDegree,
+// and the move ends one step after the target is written.
+//
+// Targets outside the joint's limits (JointLimits.h) are clamped to them and
+// counted.
+//
+// A move can also ease in and out: the first and last rampDegrees of it
+// take twice as long per degree.
+class Motion
+{
+public:
+  Motion(ArmServo *const servos[SERVO_COUNT], Telemetry &telemetry);
+
+  // Move gradually from the last commanded angle
+  void moveTo(uint8_t joint, int to, uint8_t msPerDegree, uint8_t rampDegrees = 0);
+
+  // Write an angle at once, ending any move
+  void jumpTo(uint8_t joint, int angle);
+
+  // End a move where it is now
+  void stop(uint8_t joint);
+
+  bool moving(uint8_t joint) const { return joints[joint].moving; }
+  bool idle() const;
+  int angle(uint8_t joint) const { return joints[joint].angle; }
+  // Where the joint was last told to go: the target of a move in progress,
+  // otherwise the angle it is at
+  int commanded(uint8_t joint) const { return joints[joint].moving ? joints[joint].target : joints[joint].angle; }
+  int velocity(uint8_t joint) const;
+  unsigned int clamped(uint8_t joint) const { return joints[joint].clamped; }
+
+  // Step every joint that is due. Returns true if any servo was written.
+  bool update();
+
+  // True once after any move starts, jump or stop, so the commanded pose
+  // can be checkpointed
+  bool takePoseChange()
+  {
+    bool changed = poseChanged;
+    poseChanged = false;
+    return changed;
+  }
+
+private:
+  struct Joint
+  {
+    ArmServo *servo;
+    int angle;
+    int start;
+    int target;
+    uint8_t msPerDegree;
+    uint8_t rampDegrees;
+    unsigned long lastStepMs;
+    unsigned int clamped;
+    bool moving;
+  };
+
+  int limit(uint8_t joint, int angle);
+  void finish(uint8_t joint);
+  static unsigned long stepMs(const Joint &j);
+
+  Joint joints[SERVO_COUNT];
+  Telemetry &out;
+  bool poseChanged;
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef PCA9685_H
+#define PCA9685_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+const uint8_t PCA9685_DEFAULT_ADDRESS = 0x40;
+const uint8_t PCA9685_CHANNELS = 16;
+
+// Registers used
+const uint8_t PCA9685_MODE1 = 0x00;
+const uint8_t PCA9685_LED0_ON_L = 0x06; // 4 bytes per channel: ON_L, ON_H, OFF_L, OFF_H
+const uint8_t PCA9685_PRE_SCALE = 0xFE;
+
+// MODE1 bits
+const uint8_t PCA9685_MODE1_RESTART = 0x80;
+const uint8_t PCA9685_MODE1_AI = 0x20; // Register auto-increment
+const uint8_t PCA9685_MODE1_SLEEP = 0x10;
+
+// OFF_H bit that holds a channel low (no pulses, servo limp)
+const uint8_t PCA9685_FULL_OFF = 0x10;
+
+// Nominal internal oscillator; real parts are within a few percent
+const unsigned long PCA9685_OSCILLATOR_HZ = 25000000UL;
+
+// The AVR Wire buffer is 32 bytes: one register address plus 7 channels
+const uint8_t PCA9685_CHANNELS_PER_BURST = 7;
+
+// PCA9685 driver that keeps a shadow copy of every channel and only talks
+// to the chip from flush(). Changed channels go out in one auto-increment
+// write starting at the lowest changed channel, so a whole arm update is a
+// single I2C transaction (more only if the changed channels span more than
+// PCA9685_CHANNELS_PER_BURST).
+//
+// Each channel's pulse starts at its own phase in the frame, so the servos
+// don't all draw current at the same moment.
+class Pca9685
+{
+public:
+  explicit Pca9685(TwoWire &bus, uint8_t address = PCA9685_DEFAULT_ADDRESS);
+
+  // Set the frame rate and wake the chip. Returns false if it doesn't answer.
+  bool begin(uint8_t frameHz = 50);
+
+  void setPulse(uint8_t channel, unsigned int pulseUs);
+  void setOff(uint8_t channel);
+
+  // Write the changed channels. Returns false on an I2C error; they stay
+  // marked as changed and are retried next time.
+  bool flush();
+
+  // Bytes and transactions sent so far
+  unsigned long bytesSent() const { return sentBytes; }
+  unsigned long bursts() const { return sentBursts; }
+
+private:
+  bool writeRegister(uint8_t reg, uint8_t value);
+  bool writeChannels(uint8_t first, uint8_t last);
+
+  TwoWire &wire;
+  uint8_t address;
+  uint8_t prescale;
+  uint16_t onTicks[PCA9685_CHANNELS];
+  uint16_t offTicks[PCA9685_CHANNELS]; // PCA9685_FULL_OFF << 8 when off
+  uint16_t dirty;
+  unsigned long sentBytes;
+  unsigned long sentBursts;
+};
+
+// Same interface as the Servo library's Servo class, backed by one channel
+// of a Pca9685
+class Pca9685Servo
+{
+public:
+  Pca9685Servo();
+
+  static void setController(Pca9685 &controller) { pca = &controller; }
+
+  uint8_t attach(int channel);
+  uint8_t attach(int channel, int minUs, int maxUs);
+  void detach();
+  void write(int angle);
+  void writeMicroseconds(int pulseUs);
+  int read() const { return angle; }
+  bool attached() const { return isAttached; }
+
+private:
+  static Pca9685 *pca;
+  uint8_t channel;
+  int minPulseUs;
+  int maxPulseUs;
+  int angle;
+  bool isAttached;
+};
+
+#endif
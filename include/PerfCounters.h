@@ -0,0 +1,66 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <Arduino.h>
+
+// Always-on performance counters. Everything here is a few instructions per
+// call except measureIsrLoad(), which busy-waits for up to two servo frames.
+class PerfCounters
+{
+public:
+  PerfCounters();
+
+  void reset();
+
+  // Call at the top of loop()
+  void loopTick();
+
+  // Bracket calls that block (delays, sensor reads)
+  void blockingBegin();
+  void blockingEnd();
+
+  // Bracket a servo move and call motionUpdate() on each step; the largest
+  // gap between steps of one move is kept
+  void motionBegin();
+  void motionUpdate();
+  void motionEnd() { inMotion = false; }
+
+  // Time spent in interrupt handlers during one 20 ms servo frame, found by
+  // polling the servo frame timer (Timer5) and adding up the gaps. Covers
+  // every ISR that fires (Servo, millis, serial), not just the Servo one.
+  void measureIsrLoad();
+
+  // Lowest the stack has reached since boot, from the paint pattern left
+  // before setup() ran
+  uint16_t stackUsed() const;
+  uint16_t minFreeRam() const;
+
+  uint32_t loopMinUs() const { return loopMin; }
+  uint32_t loopMaxUs() const { return loopMax; }
+  uint32_t blockingMs() const { return blockingTotalUs / 1000; }
+  uint32_t longestBlockUs() const { return longestBlock; }
+  uint32_t maxMotionGapUs() const { return maxMotionGap; }
+  uint16_t isrUsPerFrame() const { return isrUs; }
+
+  void print(Print &out) const;
+
+  // Pack the counters into payload (PERF_STATS_SIZE bytes) for EV_STATS
+  uint8_t pack(uint8_t *payload) const;
+
+private:
+  uint32_t lastLoopUs;
+  uint32_t loopMin;
+  uint32_t loopMax;
+  uint32_t blockingStartUs;
+  uint32_t blockingTotalUs;
+  uint32_t longestBlock;
+  uint8_t blockingDepth;
+  bool inMotion;
+  uint32_t lastMotionUs;
+  uint32_t maxMotionGap;
+  uint16_t isrUs;
+};
+
+const uint8_t PERF_STATS_SIZE = 26;
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef PROTOTHREAD_H
+#define PROTOTHREAD_H
+
+#include <stdint.h>
+
+// Stackless coroutines in the style of Adam Dunkels' protothreads. A
+// protothread is a function that takes a Pt and returns PT_WAITING until it
+// is done; each call resumes it where it last waited.
+//
+// Local variables do not survive a wait: keep anything needed across one in
+// a static, a global or a member of the object the protothread belongs to.
+// A switch statement can't contain a wait.
+struct Pt
+{
+  uint16_t line;
+};
+
+enum PtState : uint8_t
+{
+  PT_WAITING,
+  PT_ENDED
+};
+
+#define PT_INIT(pt) ((pt)->line = 0)
+
+#define PT_BEGIN(pt) \
+  switch ((pt)->line) \
+  {                   \
+  case 0:
+
+#define PT_END(pt)   \
+  }                  \
+  PT_INIT(pt);       \
+  return PT_ENDED
+
+#define PT_WAIT_UNTIL(pt, condition) \
+  do                                 \
+  {                                  \
+    (pt)->line = __LINE__;           \
+  case __LINE__:                     \
+    if (!(condition))                \
+      return PT_WAITING;             \
+  } while (0)
+
+#define PT_WAIT_WHILE(pt, condition) PT_WAIT_UNTIL(pt, !(condition))
+
+// Give the other tasks a turn
+#define PT_YIELD(pt)         \
+  do                         \
+  {                          \
+    (pt)->line = __LINE__;   \
+    return PT_WAITING;       \
+  case __LINE__:;            \
+  } while (0)
+
+// Run a child protothread to completion
+#define PT_SPAWN(pt, child, thread) \
+  do                                \
+  {                                 \
+    PT_INIT(child);                 \
+    PT_WAIT_WHILE(pt, (thread) == PT_WAITING); \
+  } while (0)
+
+#define PT_EXIT(pt)  \
+  do                 \
+  {                  \
+    PT_INIT(pt);     \
+    return PT_ENDED; \
+  } while (0)
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+const uint8_t SCHEDULER_MAX_TASKS = 10;
+
+// One slice of a task. It must return quickly; tasks that need to wait are
+// written as protothreads (see Protothread.h).
+typedef void (*TaskFunction)();
+
+// Cooperative fixed-priority scheduler.
+//
+// A task is released every periodUs. Among the released tasks, runOnce()
+// runs the one with the highest priority, and of those the one whose
+// deadline (release + deadlineUs) comes first. A task that starts after its
+// deadline counts as a miss. Releases that pile up while a task is late are
+// merged into one, so a slow slice never causes a burst of catch-up runs.
+class Scheduler
+{
+public:
+  Scheduler();
+
+  // Returns the task's index, or -1 if the table is full
+  int8_t add(const __FlashStringHelper *name, TaskFunction run, uint32_t periodUs,
+             uint32_t deadlineUs, uint8_t priority);
+
+  // Release every task now
+  void begin();
+
+  // Run the most urgent released task, if any. Returns true if one ran.
+  bool runOnce();
+
+  // Runs, misses, worst start latency and longest slice per task
+  void print(Print &out) const;
+  void resetStats();
+
+private:
+  struct Task
+  {
+    const __FlashStringHelper *name;
+    TaskFunction run;
+    uint32_t periodUs;
+    uint32_t deadlineUs;
+    uint8_t priority;
+    uint32_t releaseUs;
+    unsigned long runs;
+    unsigned long misses;
+    uint32_t maxLatencyUs;
+    uint32_t maxRunUs;
+  };
+
+  Task tasks[SCHEDULER_MAX_TASKS];
+  uint8_t taskCount;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SERVO_BACKEND_H
+#define SERVO_BACKEND_H
+
+// Which hardware drives the servos, chosen at compile time with
+// -DSERVO_BACKEND=... (see platformio.ini):
+//
+//   SERVO_BACKEND_TIMER    Arduino Servo library, timer-ISR PWM on Mega pins
+//   SERVO_BACKEND_PCA9685  PCA9685 16-channel I2C PWM controller; "pins"
+//                          are controller channels 0-15
+//   SERVO_BACKEND_TIMER_PWM  hardware PWM from the 16-bit timers' compare
+//                          outputs (see TimerServo.h for the usable pins)
+//
+// Both give an ArmServo class with the Servo library's attach/detach/write
+// interface, so the rest of the firmware doesn't care which one it gets.
+#define SERVO_BACKEND_TIMER 0
+#define SERVO_BACKEND_PCA9685 1
+#define SERVO_BACKEND_TIMER_PWM 2
+
+#ifndef SERVO_BACKEND
+#define SERVO_BACKEND SERVO_BACKEND_TIMER
+#endif
+
+#if SERVO_BACKEND == SERVO_BACKEND_PCA9685
+
+#include "Pca9685.h"
+
+typedef Pca9685Servo ArmServo;
+
+// The controller, on the default Wire bus at address 0x40
+extern Pca9685 servoController;
+
+// Start I2C and the controller's 50 Hz frame
+inline bool beginServos()
+{
+  Pca9685Servo::setController(servoController);
+  return servoController.begin();
+}
+
+// Send every channel changed since the last call in one burst; call once
+// per servo frame
+inline void flushServos()
+{
+  servoController.flush();
+}
+
+#elif SERVO_BACKEND == SERVO_BACKEND_TIMER_PWM
+
+#include "TimerServo.h"
+
+typedef TimerServo ArmServo;
+
+// Each timer is set up when its first servo is attached
+inline bool beginServos()
+{
+  return true;
+}
+
+inline void flushServos()
+{
+}
+
+#else
+
+#include <Servo.h>
+
+typedef Servo ArmServo;
+
+// The Servo library writes the timer registers directly
+inline bool beginServos()
+{
+  return true;
+}
+
+inline void flushServos()
+{
+}
+
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SERVO_POWER_H
+#define SERVO_POWER_H
+
+#include <Arduino.h>
+#include "Motion.h"
+#include "ServoBackend.h"
+#include "Telemetry.h"
+
+// Bit for a joint (TelemetryServo) in a joint mask
+inline uint8_t jointBit(uint8_t joint)
+{
+  return (uint8_t)(1 << joint);
+}
+
+const uint8_t ALL_JOINTS = (uint8_t)((1 << SERVO_COUNT) - 1);
+
+// Servo power management. A joint that has not moved or been written for
+// the idle timeout is detached ("asleep"), so it stops drawing holding
+// current. It is reattached at its last commanded angle (from Motion),
+// written just before attach(): every backend keeps a width written while
+// detached and starts its first pulse from it.
+//
+// Joints wake when a move starts on them, or ahead of time with wakeAt()
+// when the caller knows a move is coming, so the servo is already driven
+// and settled when the move begins. Joints in the hold mask never go to
+// sleep. Joints detached on purpose with detach() are left alone until
+// attach().
+class ServoPower
+{
+public:
+  ServoPower(ArmServo *const servos[SERVO_COUNT], const uint8_t pins[SERVO_COUNT],
+             Motion &motion, Telemetry &telemetry);
+
+  void attach(uint8_t joint);
+  void detach(uint8_t joint);
+  bool attached(uint8_t joint) const { return joints[joint].attached; }
+
+  // Reattach a sleeping joint now, e.g. just before moving it
+  void wake(uint8_t joint);
+
+  // Reattach the sleeping joints in mask once inMs has passed
+  void wakeAt(uint8_t mask, unsigned long inMs);
+
+  // Joints in mask are kept attached however long they are idle
+  void hold(uint8_t mask) { holdMask = mask; }
+
+  // Put idle joints to sleep (idleMs 0 disables it) and run scheduled wakes
+  void update(unsigned long idleMs);
+
+  // Share of the time each joint was attached, and sleep/wake counts
+  void print(Print &out) const;
+  void resetStats();
+
+private:
+  struct Joint
+  {
+    ArmServo *servo;
+    uint8_t pin;
+    bool attached;
+    bool asleep;
+    unsigned long lastActiveMs;
+    unsigned long attachedSinceMs;
+    unsigned long attachedMs;
+    unsigned int sleeps;
+    unsigned int lateWakes; // Move started before the joint was awake
+  };
+
+  void powerOn(uint8_t joint);
+  void powerOff(uint8_t joint);
+
+  Joint joints[SERVO_COUNT];
+  Motion &motion;
+  Telemetry &out;
+  uint8_t holdMask;
+  uint8_t wakeMask;
+  unsigned long wakeAtMs;
+  unsigned long statsStartMs;
+};
+
+#endif
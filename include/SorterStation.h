@@ -0,0 +1,364 @@
+#ifndef SORTER_STATION_H
+#define SORTER_STATION_H
+
+#include <Arduino.h>
+#include "Checkpoint.h"
+#include "Classifier.h"
+#include "ColorSensor.h"
+#include "FeedQueue.h"
+#include "JointLimits.h"
+#include "Motion.h"
+#include "PerfCounters.h"
+#include "Protothread.h"
+#include "ServoBackend.h"
+#include "ServoPower.h"
+#include "SortingArm.h"
+#include "StateMachine.h"
+#include "Telemetry.h"
+#include "TraceRecorder.h"
+
+// Sorting strategy (see SortingArm.h). Each can be swapped from the build
+// flags, e.g. -DGRIP_HOLD_POLICY=KeepAttached or
+// -DDETECTION_POLICY="LowestBelow<>", without any cost at run time.
+#ifndef GRIP_HOLD_POLICY
+#define GRIP_HOLD_POLICY DetachWhileHolding
+#endif
+#ifndef DETECTION_POLICY
+#define DETECTION_POLICY DominantColor
+#endif
+#ifndef MOTION_PROFILE
+#define MOTION_PROFILE LinearProfile
+#endif
+#ifndef LOG_SINK
+#define LOG_SINK TelemetrySink
+#endif
+
+typedef SortingArm<GRIP_HOLD_POLICY, DETECTION_POLICY, MOTION_PROFILE, LOG_SINK> Arm;
+
+// Longest pulse worth waiting for; anything slower is reported as a timeout
+const unsigned int sensorSlowestReading = CLASSIFIER_MAX_VALID * 4;
+
+// Below this every scan would run out of time before blue is read; the
+// 10 ms covers the scan task polling settled() only every couple of ms
+const int SENSOR_DEADLINE_MIN_MS = (int)sensorMinDeadlineMs(sensorSlowestReading) + 10;
+
+// No grip feedback input: the grip is checked on the color sensor's clear
+// channel instead
+const uint8_t GRIP_FEEDBACK_NONE = 0xFF;
+
+// Where one arm is wired: its servos (indexed by TelemetryServo; PCA9685
+// channels with SERVO_BACKEND_PCA9685), its color sensor, and an optional
+// switch that pulls gripFeedback low while the grabber holds something
+struct StationPins
+{
+  uint8_t servos[SERVO_COUNT];
+  uint8_t s0;
+  uint8_t s1;
+  uint8_t s2;
+  uint8_t s3;
+  uint8_t sensorOut;
+  uint8_t gripFeedback;
+};
+
+// One arm's positions, in degrees. Each arm has its own, so arms that are
+// mounted differently can be tuned separately.
+struct ArmPoses
+{
+  // Base positions
+  int baseBluePos = Pose<SERVO_BASE, 90>::value;  // Left position (blue drop location)
+  int baseRedPos = Pose<SERVO_BASE, 60>::value;   // Middle-left position (red drop location)
+  int baseGreenPos = Pose<SERVO_BASE, 30>::value; // Middle-right position (green drop location)
+  int baseObjectPos = Pose<SERVO_BASE, 0>::value; // Forward position (object pickup)
+
+  // Grabber positions
+  int grabberOpenPos = Pose<SERVO_GRABBER2, 70>::value;  // Open position (based on your test code)
+  int grabberClosedPos = Pose<SERVO_GRABBER2, 0>::value; // Closed position (based on your test code)
+
+  // Joint positions
+  int jointPickPos = Pose<SERVO_JOINT, 90>::value; // Joint position for picking objects
+  int jointLiftPos = Pose<SERVO_JOINT, 0>::value;  // Joint position for lifting objects
+
+  // Grabber servo 1 positions
+  int grabber1RestPos = Pose<SERVO_GRABBER1, 90>::value;  // Initial position
+  int grabber1PickPos = Pose<SERVO_GRABBER1, 150>::value; // Optimal position for picking
+
+  // Arm positions
+  int armPickPos = Pose<SERVO_ARM, 140>::value;    // Arm position for picking objects
+  int armMidPos = Pose<SERVO_ARM, 60>::value;      // Arm mid position
+  int armRestPos = Pose<SERVO_ARM, 0>::value;      // Arm rest position
+  int armReleasePos = Pose<SERVO_ARM, 120>::value; // Safe release position
+};
+
+// Timing and sensing settings shared by every arm
+struct SorterSettings
+{
+  // Speeds (ms per degree)
+  int moveDelayMs = 15;     // Arm, joint and grabber moves
+  int baseMoveDelayMs = 20; // Base rotation
+
+  // Dwells (ms)
+  int stepDwellMs = 1000;   // After each step of a sequence
+  int attachDwellMs = 500;  // After attaching the grabber at the start of a pick
+  int settleDwellMs = 2000; // After base moves and after letting go of an object
+  int retryDwellMs = 1000;  // Between detection attempts
+  int cycleDwellMs = 3000;  // After a completed cycle
+  int idleDwellMs = 2000;   // After a cycle without an object
+
+  // Detection attempts per pick
+  int maxAttempts = 5;
+
+  // Hard limit on one three-channel classification, at least
+  // SENSOR_DEADLINE_MIN_MS
+  int sensorDeadlineMs = 600;
+
+  // Watch the clear channel while the arm approaches the pick position, and
+  // turn back if nothing has shown up by the time the arm passes
+  // armSenseAbortPos. A clear reading at or below approachPresenceMax counts
+  // as an object, here and on the feed.
+  int armSenseAbortPos = 120;
+  int approachPresenceMax = CLASSIFIER_MAX_VALID;
+
+  // Servos that sit idle for powerIdleMs are detached until they are needed
+  // again, and woken powerLeadMs ahead of a cycle (0 never detaches)
+  int powerIdleMs = 2500;
+  int powerLeadMs = 100;
+
+  // Time from the upstream sensor to the pick position
+  int feedTravelMs = 4000;
+
+  // Once the grabber has closed, check that it holds the object: on the
+  // feedback input if the arm has one, otherwise on the clear channel
+  // (approachPresenceMax). An empty grabber opens and closes again up to
+  // gripRetries times before the pick is abandoned.
+  int gripRetries = 1;
+};
+
+// Result of one detection attempt
+enum DetectResult
+{
+  DETECT_NONE,    // Read fine, but no clear color
+  DETECT_OBJECT,  // Read fine and classified
+  DETECT_TIMEOUT  // Sensor gave no answer in time
+};
+
+// What the cycle wants from the color scanning task
+enum ScanRequest
+{
+  SCAN_IDLE,
+  SCAN_PRESENCE, // Keep sampling the clear channel, set presenceSeen
+  SCAN_COLOR,    // Take one red/green/blue reading, then set scanDone
+  SCAN_FEED,     // Read every object passing upstream, set feedReadingDone
+  SCAN_GRIP      // Take one clear channel reading, then set scanDone
+};
+
+// One complete sorter: an arm with its own servos, color sensor, poses and
+// sorting cycle. Any number of them can share the board; each of the
+// update functions below is called for every station from the same
+// scheduler task, and none of them block.
+//
+// The cycle's states are shared by all stations; the state machine's
+// context tells the handlers which station they are running for.
+class SorterStation
+{
+public:
+  SorterStation(uint8_t index, const StationPins &pins, ArmPoses &poses, SorterSettings &settings,
+                Telemetry &telemetry, PerfCounters &perf, TraceRecorder &traceRecorder);
+
+  // Attach the servos and start the cycle. The pose and cycle phase are
+  // checkpointed in a ring of checkpointSlots slots at checkpointAddress;
+  // if a valid one is there the arm picks up from it instead of homing.
+  // A dispatched station doesn't look for objects itself: it waits for the
+  // host to assign them with assignObject().
+  void begin(int checkpointAddress, uint8_t checkpointSlots, bool dispatched = false);
+
+  // Scheduler work, one call per task run. updateMotion() returns true if
+  // a servo was written.
+  bool updateMotion();
+  void updateScan();
+  void updateCycle();
+  void updatePower();
+  void updateCheckpoint();
+
+  bool motionIdle() const { return motion.idle(); }
+
+  // Nothing moving and nothing being read, so a busy-wait here would hold
+  // up no one
+  bool quiet() const { return motion.idle() && scanRequest == SCAN_IDLE; }
+  uint8_t index() const { return id; }
+
+  // Command interface
+  void printJoints(Print &out) const;
+  void printPower(Print &out) const { power.print(out); }
+  void resetPowerStats() { power.resetStats(); }
+  void printFeed(Print &out) const { feedQueue.print(out); }
+  void clearFeed() { feedQueue.clear(); }
+  void requestSelfTest() { selfTestRequested = true; }
+  void printGrip(Print &out) const;
+  void resetGripStats();
+
+  // Queue an object the host saw on the shared feed, arriving at the pick
+  // position in travelMs. Returns false if the feed queue is full.
+  bool assignObject(Color color, unsigned long travelMs);
+
+  // Load and throughput, for the host dispatcher
+  uint8_t objectsQueued() const { return feedQueue.count(); }
+  uint8_t queueRoom() const { return FEED_QUEUE_SIZE - feedQueue.count(); }
+  unsigned int objectsDropped() const { return feedQueue.dropped(); }
+  unsigned long objectsSorted() const { return sortedCount; }
+  unsigned long lastCycleMs() const { return lastCycleLengthMs; }
+
+private:
+  // Step bookkeeping
+  void startDwell(unsigned int ms);
+  bool dwellDone();
+  void startMove(uint8_t joint, int endAngle, int delayMs);
+  void runDwell(unsigned int ms);
+  void runStep(uint8_t joint, int endAngle, int delayMs, unsigned int dwellMs);
+  void awaitStep(uint8_t joint, unsigned int dwellMs);
+  void cancelStep();
+  void moveToPose(const int pose[SERVO_COUNT]);
+
+  // Sensing
+  SensorStatus sampleSensor(uint16_t &value);
+  PtState colorScan(Pt *pt);
+  int binPosition(Color color) const;
+  DetectResult classifyScan();
+  DetectResult detectObject();
+  bool armPastAbortPos() const;
+  bool queueFeedObject();
+  void takeQueuedObject();
+  bool nextObjectSensed() const;
+  bool queuedFeed() const;
+  void endCycle();
+  void startScan();
+  bool gripCheckable() const;
+  void startGripCheck();
+  void finishGripCheck(StateMachine &machine);
+
+  const State &recoveryState(const CheckpointRecord &saved);
+  void reportState(uint8_t id);
+  void saveCheckpoint();
+  static void observeState(StateMachine &machine, uint8_t id);
+
+  // The cycle's states (see SorterStation.cpp). Each handler is a member
+  // function, reached through stateHandler<> from the shared State table.
+  template <bool (SorterStation::*Handler)(StateMachine &, uint8_t)>
+  static bool stateHandler(StateMachine &machine, uint8_t signal)
+  {
+    return (static_cast<SorterStation *>(machine.context())->*Handler)(machine, signal);
+  }
+
+  bool activeState(StateMachine &machine, uint8_t signal);
+  bool homingState(StateMachine &machine, uint8_t signal);
+  bool resumeState(StateMachine &machine, uint8_t signal);
+  bool recoverState(StateMachine &machine, uint8_t signal);
+  bool idleState(StateMachine &machine, uint8_t signal);
+  void startApproachMove();
+  bool approachState(StateMachine &machine, uint8_t signal);
+  bool senseState(StateMachine &machine, uint8_t signal);
+  bool gripState(StateMachine &machine, uint8_t signal);
+  bool transferState(StateMachine &machine, uint8_t signal);
+  bool releaseState(StateMachine &machine, uint8_t signal);
+  bool returnState(StateMachine &machine, uint8_t signal);
+  bool returnEmptyState(StateMachine &machine, uint8_t signal);
+  bool returnFromBinState(StateMachine &machine, uint8_t signal);
+  bool returnToPickState(StateMachine &machine, uint8_t signal);
+
+  static const State active;
+  static const State homing;
+  static const State resume;
+  static const State recover;
+  static const State idle;
+  static const State approach;
+  static const State sense;
+  static const State grip;
+  static const State transfer;
+  static const State release;
+  static const State returning;
+  static const State returnEmpty;
+  static const State returnFromBin;
+  static const State returnToPick;
+
+  uint8_t id;
+  ArmPoses &poses;
+  SorterSettings &settings;
+  Telemetry &telemetry;
+  PerfCounters &perf;
+  TraceRecorder &traceRecorder;
+
+  // Hardware, in construction order
+  ArmServo servos[SERVO_COUNT];
+  ArmServo *const servoList[SERVO_COUNT];
+  Motion motion;
+  ServoPower power;
+  Arm arm;
+  ColorSensor colorSensor;
+
+  Checkpoint checkpoint;
+  uint8_t checkpointPhase; // State the checkpoints are taken in
+  FeedQueue feedQueue;
+
+  // Color frequency readings (0.1us pulse width at 20% scaling, see ColorSensor.h)
+  uint16_t redFreq;
+  uint16_t greenFreq;
+  uint16_t blueFreq;
+
+  // Detected color
+  Color detectedColor;
+  int targetBasePosition;
+  boolean objectDetected;
+  unsigned long sensorTimeouts; // Detection attempts lost to sensor timeouts
+  uint8_t sensorScaleUsed;      // Scaling the last reading was taken at
+
+  // Color scanning task, and what it keeps across waits
+  ScanRequest scanRequest;
+  boolean presenceSeen;
+  boolean scanDone;
+  SensorStatus scanStatus;
+  ColorReading scanReading;
+  boolean feedReadingDone;
+  unsigned long feedSensedMs; // When the last feed reading started
+  boolean feedAssigned;       // The host queued an object
+  boolean dispatched;         // Objects come from the host, not the sensor
+  Pt scanPt;
+  uint8_t scanChannel;
+  unsigned long scanStartMs;
+  unsigned long scanStartUs;
+  ColorReading scanNext;
+  uint16_t scanClear;
+  uint8_t scanFlags;
+
+  // The sorting cycle, as a hierarchical state machine
+  StateMachine cycle;
+
+  // The step the current state is on: an optional move, then a dwell. The
+  // cycle task turns the end of the move into SIG_MOTION_DONE and the end of
+  // the dwell into SIG_STEP_DONE.
+  uint8_t waitingJoint;
+  unsigned int pendingDwellMs;
+  boolean dwellActive;
+  unsigned long dwellStartMs;
+  unsigned int dwellLengthMs;
+  uint8_t stateStep;
+
+  // Per-cycle bookkeeping
+  int attempts;                // Detection attempts so far
+  Color sorted;                // What the cycle delivered
+  boolean approachWatching;    // Approach move is waiting for the clear channel
+  boolean approachFromBin;     // Grabber already open and positioned, skip to step 4
+  boolean selfTestRequested;   // Set by the "selftest" command
+  unsigned long cycleStartMs;  // When the current cycle started
+  unsigned long sortedCount;   // Cycles that delivered an object
+  unsigned long lastCycleLengthMs;
+
+  // Grip verification
+  uint8_t gripFeedbackPin;      // GRIP_FEEDBACK_NONE to use the clear channel
+  uint8_t gripGrabs;            // Times the grabber has closed on this object
+  boolean gripPending;          // Clear channel reading under way
+  boolean gripWaiting;          // Step 7 is over, waiting for that reading
+  unsigned long gripChecks;     // Grabs checked
+  unsigned long gripsHeld;      // Grabs that held the object
+  unsigned long gripsAbandoned; // Picks given up after every re-grab missed
+};
+
+#endif
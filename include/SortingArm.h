@@ -0,0 +1,193 @@
+#ifndef SORTING_ARM_H
+#define SORTING_ARM_H
+
+#include <Arduino.h>
+#include "Classifier.h"
+#include "Log.h"
+#include "Motion.h"
+#include "ServoBackend.h"
+#include "ServoPower.h"
+#include "Telemetry.h"
+
+// The parts of the sorter that differ between the firmware variants (the
+// sketches in component/ each hard-coded one combination), as policy
+// classes picked at compile time:
+//
+//   GripHold   what grabberServo2 does while it holds an object
+//   Detection  how a color reading becomes a color
+//   Profile    how gradual moves are paced
+//   Sink       where the arm's step events go
+//
+// Every policy call is a static or inline member resolved by the compiler,
+// with no virtual functions, so an unused option costs nothing and the
+// chosen combination builds to the same code as writing it out by hand.
+
+// Grip-hold policies. gripped() runs once the grabber has closed on the
+// object, releasing() before it opens over the bin and parked() at the end
+// of a cycle.
+
+// Let grabberServo2 go limp while holding so it doesn't stall against the
+// object and overheat (main.cpp, servo_detach_grabber.cpp)
+struct DetachWhileHolding
+{
+  template <class Arm>
+  static void gripped(Arm &arm)
+  {
+    LOG_INFO(F("Detaching grabber servo to prevent overheating"));
+    arm.detach(SERVO_GRABBER2);
+  }
+
+  template <class Arm>
+  static void releasing(Arm &arm)
+  {
+    LOG_INFO(F("Reattaching grabber servo"));
+    arm.attach(SERVO_GRABBER2);
+  }
+
+  template <class Arm>
+  static void parked(Arm &arm)
+  {
+    LOG_INFO(F("Detaching grabber servo until next cycle"));
+    arm.detach(SERVO_GRABBER2);
+  }
+};
+
+// Keep holding torque the whole time, for objects that slip out of a limp
+// grabber (aervo_with_attach_grabber.cpp)
+struct KeepAttached
+{
+  template <class Arm>
+  static void gripped(Arm &)
+  {
+  }
+
+  template <class Arm>
+  static void releasing(Arm &)
+  {
+  }
+
+  template <class Arm>
+  static void parked(Arm &)
+  {
+  }
+};
+
+// Detection policies
+
+// A valid channel clearly below the other valid ones (see classifyColor())
+struct DominantColor
+{
+  static Classification classify(const ColorReading &reading)
+  {
+    return classifyColor(reading);
+  }
+};
+
+// The shortest pulse, if it is short enough (servo_color_final.cpp)
+template <uint16_t Limit = CLASSIFIER_LOWEST_LIMIT>
+struct LowestBelow
+{
+  static Classification classify(const ColorReading &reading)
+  {
+    return classifyLowest(reading, Limit);
+  }
+};
+
+// Motion profiles
+
+// Every degree held for the same time, like the original moveServoGradually()
+struct LinearProfile
+{
+  static const uint8_t rampDegrees = 0;
+};
+
+// Half speed over the first and last Degrees of every move, which is gentler
+// on the gears and on whatever the grabber is holding
+template <uint8_t Degrees>
+struct EasedProfile
+{
+  static const uint8_t rampDegrees = Degrees;
+};
+
+// Logging sinks, for the arm's step events (attach and detach are reported
+// by ServoPower)
+
+struct TelemetrySink
+{
+  explicit TelemetrySink(Telemetry &telemetry) : out(telemetry) {}
+
+  void send(TelemetryEvent event, uint8_t value) { out.send(event, value); }
+  void send(TelemetryEvent event, uint8_t first, uint8_t second) { out.send(event, first, second); }
+
+  Telemetry &out;
+};
+
+// Drop them, for builds that only want the text log
+struct NullSink
+{
+  explicit NullSink(Telemetry &) {}
+
+  void send(TelemetryEvent, uint8_t) {}
+  void send(TelemetryEvent, uint8_t, uint8_t) {}
+};
+
+// One arm: the power manager that attaches its servos (indexed by
+// TelemetryServo) and the motion engine that steps them
+template <class GripHold, class Detection, class Profile, class Sink>
+class SortingArm
+{
+public:
+  SortingArm(ServoPower &servoPower, Motion &motion, Telemetry &telemetry)
+      : power(servoPower), joints(motion), sink(telemetry)
+  {
+  }
+
+  void attach(uint8_t joint) { power.attach(joint); }
+  void detach(uint8_t joint) { power.detach(joint); }
+
+  // Jump straight to an angle
+  void write(uint8_t joint, int angle)
+  {
+    joints.jumpTo(joint, angle);
+    power.wake(joint);
+  }
+
+  // Start a gradual move from wherever the joint was last sent, paced by
+  // the profile. A sleeping joint is woken first.
+  void move(uint8_t joint, int to, uint8_t msPerDegree)
+  {
+    power.wake(joint);
+    joints.moveTo(joint, to, msPerDegree, Profile::rampDegrees);
+  }
+
+  JointState state(uint8_t joint) const
+  {
+    JointState s = {joints.angle(joint), joints.velocity(joint), power.attached(joint)};
+    return s;
+  }
+
+  // Keep the joints in mask powered, e.g. while they carry a load
+  void hold(uint8_t mask) { power.hold(mask); }
+
+  // Have the joints in mask awake by the time a move starts in inMs
+  void wakeBefore(uint8_t mask, unsigned long inMs, unsigned long leadMs)
+  {
+    power.wakeAt(mask, inMs > leadMs ? inMs - leadMs : 0);
+  }
+
+  // Mark the start of a numbered step in a sequence
+  void step(TelemetrySequence sequence, uint8_t number) { sink.send(EV_STEP, sequence, number); }
+
+  Classification classify(const ColorReading &reading) const { return Detection::classify(reading); }
+
+  void gripped() { GripHold::gripped(*this); }
+  void releasing() { GripHold::releasing(*this); }
+  void parked() { GripHold::parked(*this); }
+
+private:
+  ServoPower &power;
+  Motion &joints;
+  Sink sink;
+};
+
+#endif
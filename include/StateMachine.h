@@ -0,0 +1,64 @@
+#ifndef STATE_MACHINE_H
+#define STATE_MACHINE_H
+
+#include <stdint.h>
+
+// Signals every state gets; the firmware's own start at SIG_USER
+const uint8_t SIG_ENTRY = 0;
+const uint8_t SIG_EXIT = 1;
+const uint8_t SIG_USER = 2;
+
+const uint8_t STATE_MAX_DEPTH = 4;
+
+class StateMachine;
+
+// Returns true if the state handled the signal. Unhandled signals go on to
+// the parent state. ENTRY and EXIT results are ignored.
+typedef bool (*StateHandler)(StateMachine &machine, uint8_t signal);
+
+// A state and its place in the hierarchy. id is reported to the observer.
+struct State
+{
+  StateHandler handler;
+  const State *parent;
+  uint8_t id;
+};
+
+// Hierarchical state machine. dispatch() offers a signal to the current
+// state and then its parents. A handler that calls transition() leaves the
+// states up to the nearest common parent (innermost first) and enters the
+// path down to the target. An ENTRY handler may itself transition, which is
+// how a parent picks its initial child.
+class StateMachine
+{
+public:
+  StateMachine();
+
+  // Called with the id of every state as it is entered
+  void setObserver(void (*observer)(StateMachine &machine, uint8_t id)) { onEnter = observer; }
+
+  // Whatever the handlers act on, for machines that run more than once
+  // (one per arm) with the same states
+  void setContext(void *context) { owner = context; }
+  void *context() const { return owner; }
+
+  void start(const State &initial);
+  void dispatch(uint8_t signal);
+  void transition(const State &target) { pending = &target; }
+
+  const State *state() const { return current; }
+
+  // True if s is the current state or one of its parents
+  bool in(const State &s) const;
+
+private:
+  void runTransitions();
+  static bool contains(const State *outer, const State *inner);
+
+  const State *current;
+  const State *pending;
+  void (*onEnter)(StateMachine &machine, uint8_t id);
+  void *owner;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <Arduino.h>
+#include "TelemetryFormat.h"
+
+// Size of the transmit ring. Frames are queued here and drained into the
+// serial TX buffer only as fast as it has room, so sending never blocks.
+const uint16_t TELEMETRY_RING_SIZE = 1024;
+
+// Called with every message passed to send(), whether or not it fits in the
+// ring, so an in-RAM log can keep up even when the link can't
+typedef void (*TelemetryTap)(TelemetryEvent event, uint32_t timeUs, const uint8_t *payload, uint8_t length);
+
+// Binary telemetry stream (see TelemetryFormat.h for the wire format).
+//
+// send() queues a whole frame or nothing: if the ring is full the frame is
+// dropped and counted. flush() must be called regularly; main.cpp does it
+// from yield(), which delay() calls while it waits.
+class Telemetry
+{
+public:
+  Telemetry();
+
+  void begin(HardwareSerial &serialPort, unsigned long baud);
+
+  void setTap(TelemetryTap tap) { messageTap = tap; }
+
+  // Frames sent from now on come from this arm. An EV_ARM marker goes out
+  // ahead of the first one that comes from a different arm than the last,
+  // so a single-arm build never sends it.
+  void setSource(uint8_t arm) { source = arm; }
+
+  bool send(TelemetryEvent event, const uint8_t *payload = 0, uint8_t length = 0);
+  bool send(TelemetryEvent event, uint8_t value);
+  bool send(TelemetryEvent event, uint8_t first, uint8_t second);
+
+  // Move queued bytes into the serial TX buffer without waiting
+  void flush();
+
+  unsigned long dropped() const { return droppedFrames; }
+  uint16_t queued() const;
+
+  // Print interface for human-readable lines; each line becomes one
+  // EV_TEXT frame
+  Print &text() { return textChannel; }
+
+private:
+  class TextChannel : public Print
+  {
+  public:
+    explicit TextChannel(Telemetry &owner);
+    size_t write(uint8_t c);
+    using Print::write;
+
+  private:
+    Telemetry &telemetry;
+    uint8_t line[TELEMETRY_MAX_PAYLOAD];
+    uint8_t length;
+  };
+
+  HardwareSerial *port;
+  uint8_t ring[TELEMETRY_RING_SIZE];
+  uint16_t head;
+  uint16_t tail;
+  unsigned long droppedFrames;
+  TelemetryTap messageTap;
+  bool reportDrops;
+  uint8_t source;
+  uint8_t markedSource;
+  TextChannel textChannel;
+};
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef TELEMETRY_FORMAT_H
+#define TELEMETRY_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Telemetry frame format, shared by the firmware and the host tools.
+//
+// Before framing, a message is
+//
+//   offset  size  field
+//        0     1  event id (TelemetryEvent)
+//        1     4  micros() when the event was queued
+//        5     n  payload, layout per event below
+//      5+n     2  CRC-16/CCITT-FALSE of bytes 0..4+n
+//
+// and goes out COBS-encoded followed by a single 0x00 delimiter. All
+// multi-byte fields are little-endian.
+const uint8_t TELEMETRY_HEADER_SIZE = 5;
+const uint8_t TELEMETRY_CRC_SIZE = 2;
+const uint8_t TELEMETRY_MAX_PAYLOAD = 48;
+const uint8_t TELEMETRY_MAX_MESSAGE = TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_SIZE;
+// COBS adds one byte per 254 plus the leading code byte
+const uint8_t TELEMETRY_MAX_FRAME = TELEMETRY_MAX_MESSAGE + 1 + 1;
+
+enum TelemetryEvent : uint8_t
+{
+  EV_BOOT = 0x01,           // (none)
+  EV_TEXT = 0x02,           // ASCII line without the newline
+  EV_DROPPED = 0x03,        // u32 frames dropped so far
+
+  EV_CYCLE_START = 0x10,    // (none)
+  EV_CYCLE_END = 0x11,      // u8 Color sorted, COLOR_NONE if nothing was picked
+  EV_STEP = 0x12,           // u8 TelemetrySequence, u8 step number
+  EV_STATE = 0x13,          // u8 TelemetryState entered
+  EV_ARM = 0x14,            // u8 arm index; the events after it come from that arm
+
+  EV_MOVE_START = 0x20,     // u8 TelemetryServo, u8 from, u8 to, u8 ms per degree
+  EV_MOVE_END = 0x21,       // u8 TelemetryServo, u8 angle reached
+  EV_DWELL_START = 0x22,    // u16 ms
+  EV_DWELL_END = 0x23,      // (none)
+  EV_ATTACH = 0x24,         // u8 TelemetryServo
+  EV_DETACH = 0x25,         // u8 TelemetryServo
+
+  EV_SENSE_START = 0x30,    // (none)
+  EV_SENSE_RESULT = 0x31,   // u8 DetectResult, u8 Color, u16 red, u16 green, u16 blue, u8 scale %
+  EV_ATTEMPT = 0x32,        // u8 attempt, u8 of
+  EV_APPROACH_ABORT = 0x33, // u8 arm angle
+  EV_TRACE = 0x34,          // TraceFormat.h record
+  EV_FEED_OBJECT = 0x35,    // u8 Color, u8 objects queued, u16 ms until it reaches the pick
+  EV_GRIP_CHECK = 0x36,     // u8 1 if the object is held, u8 grab (1 = first), u16 clear
+                            // reading, 0xFFFF when the feedback input was used
+
+  EV_STATS = 0x40           // u32 loop min us, u32 loop max us, u32 blocking ms,
+                            // u32 longest block us, u32 max motion gap us,
+                            // u16 ISR us per frame, u16 stack used, u16 min free RAM
+};
+
+// Which blocking sequence an EV_STEP belongs to
+enum TelemetrySequence : uint8_t
+{
+  SEQ_SETUP,
+  SEQ_PICK,
+  SEQ_RELEASE
+};
+
+// States of the sorting cycle (see main.cpp). Parents are entered (and
+// reported) before their children.
+enum TelemetryState : uint8_t
+{
+  STATE_ACTIVE,         // Parent of everything below
+  STATE_HOMING,
+  STATE_IDLE,
+  STATE_APPROACH,
+  STATE_SENSE,
+  STATE_GRIP,
+  STATE_TRANSFER,
+  STATE_RELEASE,
+  STATE_RETURN,         // Parent of the three ways back
+  STATE_RETURN_EMPTY,   // Nothing picked: arm back to rest
+  STATE_RETURN_FROM_BIN,
+  STATE_RETURN_TO_PICK, // Next object already sensed: straight back to the pick
+  STATE_RESUME,         // Warm boot: straight from the checkpointed pose to ready
+  STATE_RECOVER,        // Warm boot holding an object: carry it on to its bin
+  STATE_COUNT
+};
+
+enum TelemetryServo : uint8_t
+{
+  SERVO_BASE,
+  SERVO_ARM,
+  SERVO_JOINT,
+  SERVO_GRABBER1,
+  SERVO_GRABBER2,
+  SERVO_COUNT
+};
+
+inline uint16_t telemetryCrc16(const uint8_t *data, size_t length)
+{
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < length; i++)
+  {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// COBS-encode length bytes into out (room for length + length / 254 + 1).
+// Returns the encoded length, not counting the 0x00 delimiter.
+inline size_t cobsEncode(const uint8_t *in, size_t length, uint8_t *out)
+{
+  size_t codeIndex = 0;
+  size_t outIndex = 1;
+  uint8_t code = 1;
+
+  for (size_t i = 0; i < length; i++)
+  {
+    if (in[i] == 0)
+    {
+      out[codeIndex] = code;
+      codeIndex = outIndex++;
+      code = 1;
+      continue;
+    }
+
+    out[outIndex++] = in[i];
+    if (++code == 0xFF)
+    {
+      out[codeIndex] = code;
+      codeIndex = outIndex++;
+      code = 1;
+    }
+  }
+  out[codeIndex] = code;
+  return outIndex;
+}
+
+// Decode one COBS frame (without its delimiter) into out, which needs
+// length bytes. Returns the decoded length, or 0 if the frame is malformed.
+inline size_t cobsDecode(const uint8_t *in, size_t length, uint8_t *out)
+{
+  size_t inIndex = 0;
+  size_t outIndex = 0;
+
+  while (inIndex < length)
+  {
+    uint8_t code = in[inIndex++];
+    if (code == 0 || inIndex + code - 1 > length)
+    {
+      return 0;
+    }
+    for (uint8_t i = 1; i < code; i++)
+    {
+      out[outIndex++] = in[inIndex++];
+    }
+    if (code != 0xFF && inIndex < length)
+    {
+      out[outIndex++] = 0;
+    }
+  }
+  return outIndex;
+}
+
+struct TelemetryMessage
+{
+  TelemetryEvent event;
+  uint32_t timeUs;
+  const uint8_t *payload;
+  uint8_t payloadLength;
+};
+
+// Check and split a decoded message. payload points into the message.
+inline bool parseTelemetryMessage(const uint8_t *message, size_t length, TelemetryMessage &out)
+{
+  if (length < TELEMETRY_HEADER_SIZE + TELEMETRY_CRC_SIZE ||
+      length > TELEMETRY_MAX_MESSAGE)
+  {
+    return false;
+  }
+
+  size_t body = length - TELEMETRY_CRC_SIZE;
+  uint16_t crc = (uint16_t)(message[body] | (message[body + 1] << 8));
+  if (crc != telemetryCrc16(message, body))
+  {
+    return false;
+  }
+
+  out.event = (TelemetryEvent)message[0];
+  out.timeUs = (uint32_t)message[1] | ((uint32_t)message[2] << 8) |
+               ((uint32_t)message[3] << 16) | ((uint32_t)message[4] << 24);
+  out.payload = message + TELEMETRY_HEADER_SIZE;
+  out.payloadLength = (uint8_t)(body - TELEMETRY_HEADER_SIZE);
+  return true;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef TIMER_SERVO_H
+#define TIMER_SERVO_H
+
+#include <Arduino.h>
+
+// Servo pulses straight from the Mega's 16-bit timers. Each timer runs in
+// fast PWM mode with a 20 ms period (TOP in ICRn, 0.5 us per tick) and every
+// servo is one output-compare channel, so the pulses are produced entirely in
+// hardware: no interrupts, no jitter from other ISRs. OCRnx is
+// double-buffered in this mode, so a new width takes effect at the start of
+// the next frame and never cuts a pulse short.
+//
+// Usable pins (timer/channel):
+//
+//   Timer1: 11 (A), 12 (B), 13 (C)     Timer3: 5 (A), 2 (B), 3 (C)
+//   Timer4:  6 (A),  7 (B),  8 (C)     Timer5: 46 (A), 45 (B), 44 (C)
+//
+// Only the channels of attached servos drive their pins; the other pins on
+// the same timer stay ordinary I/O. A timer used here is no longer available
+// for analogWrite() on any of its pins.
+const uint8_t TIMER_SERVO_INVALID = 255;
+
+class TimerServo
+{
+public:
+  TimerServo();
+
+  // Returns the pin, or TIMER_SERVO_INVALID if it has no 16-bit timer output
+  uint8_t attach(int pin);
+  uint8_t attach(int pin, int minUs, int maxUs);
+  void detach();
+  void write(int angle);
+  void writeMicroseconds(int pulseUs);
+  int read() const { return angle; }
+  bool attached() const { return isAttached; }
+
+private:
+  uint8_t pin;
+  uint8_t timer;
+  uint8_t channel;
+  int minPulseUs;
+  int maxPulseUs;
+  int angle;
+  bool isAttached;
+};
+
+#endif
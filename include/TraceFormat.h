@@ -0,0 +1,107 @@
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stdint.h>
+#include "Color.h"
+
+// Binary sensor trace record, shared by the firmware recorder and the host
+// replay tool. Each record is the payload of one EV_TRACE telemetry frame,
+// so it goes out COBS-framed and CRC-checked like every other event (see
+// TelemetryFormat.h). The sync bytes and checksum are part of the record
+// and decodeTraceRecord() still checks them.
+//
+//   offset  size  field
+//        0     2  sync (0xA5 0x5A)
+//        2     4  read start, micros()
+//        6     2  read duration, ms
+//        8     2  red    (0.1us at 20% scaling)
+//       10     2  green
+//       12     2  blue
+//       14     2  clear
+//       16     1  sensor scaling in percent
+//       17     1  operator label (Color)
+//       18     1  flags (TRACE_FLAG_*)
+//       19     1  checksum: bytes 2-18 plus this one sum to 0
+//
+// All multi-byte fields are little-endian.
+const uint8_t TRACE_SYNC1 = 0xA5;
+const uint8_t TRACE_SYNC2 = 0x5A;
+const uint8_t TRACE_RECORD_SIZE = 20;
+
+const uint8_t TRACE_FLAG_CYCLE_START = 0x01; // First reading of a pick attempt
+const uint8_t TRACE_FLAG_TIMEOUT = 0x02;     // Sensor timed out, values are stale
+const uint8_t TRACE_FLAG_NO_CLEAR = 0x04;    // Clear channel timed out
+
+struct TraceSample
+{
+  uint32_t startUs;
+  uint16_t durationMs;
+  ColorReading reading;
+  uint16_t clear;
+  uint8_t scalePercent;
+  Color label;
+  uint8_t flags;
+};
+
+inline void encodeTraceRecord(const TraceSample &sample, uint8_t *out)
+{
+  out[0] = TRACE_SYNC1;
+  out[1] = TRACE_SYNC2;
+  out[2] = (uint8_t)sample.startUs;
+  out[3] = (uint8_t)(sample.startUs >> 8);
+  out[4] = (uint8_t)(sample.startUs >> 16);
+  out[5] = (uint8_t)(sample.startUs >> 24);
+  out[6] = (uint8_t)sample.durationMs;
+  out[7] = (uint8_t)(sample.durationMs >> 8);
+  out[8] = (uint8_t)sample.reading.red;
+  out[9] = (uint8_t)(sample.reading.red >> 8);
+  out[10] = (uint8_t)sample.reading.green;
+  out[11] = (uint8_t)(sample.reading.green >> 8);
+  out[12] = (uint8_t)sample.reading.blue;
+  out[13] = (uint8_t)(sample.reading.blue >> 8);
+  out[14] = (uint8_t)sample.clear;
+  out[15] = (uint8_t)(sample.clear >> 8);
+  out[16] = sample.scalePercent;
+  out[17] = (uint8_t)sample.label;
+  out[18] = sample.flags;
+
+  uint8_t sum = 0;
+  for (uint8_t i = 2; i < TRACE_RECORD_SIZE - 1; i++)
+  {
+    sum += out[i];
+  }
+  out[TRACE_RECORD_SIZE - 1] = (uint8_t)(0 - sum);
+}
+
+// Returns false if in doesn't hold a valid record
+inline bool decodeTraceRecord(const uint8_t *in, TraceSample &sample)
+{
+  if (in[0] != TRACE_SYNC1 || in[1] != TRACE_SYNC2)
+  {
+    return false;
+  }
+
+  uint8_t sum = 0;
+  for (uint8_t i = 2; i < TRACE_RECORD_SIZE; i++)
+  {
+    sum += in[i];
+  }
+  if (sum != 0)
+  {
+    return false;
+  }
+
+  sample.startUs = (uint32_t)in[2] | ((uint32_t)in[3] << 8) |
+                   ((uint32_t)in[4] << 16) | ((uint32_t)in[5] << 24);
+  sample.durationMs = (uint16_t)(in[6] | (in[7] << 8));
+  sample.reading.red = (uint16_t)(in[8] | (in[9] << 8));
+  sample.reading.green = (uint16_t)(in[10] | (in[11] << 8));
+  sample.reading.blue = (uint16_t)(in[12] | (in[13] << 8));
+  sample.clear = (uint16_t)(in[14] | (in[15] << 8));
+  sample.scalePercent = in[16];
+  sample.label = (Color)in[17];
+  sample.flags = in[18];
+  return true;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <Arduino.h>
+#include "Telemetry.h"
+#include "TraceFormat.h"
+
+// Streams raw sensor readings as binary trace records (see TraceFormat.h),
+// carried in EV_TRACE telemetry frames, for offline replay with
+// tools/trace_replay.
+//
+// The operator sets the true color of the objects being presented with the
+// "label" command (see handleCommand() in main.cpp). Every record carries
+// the current label.
+class TraceRecorder
+{
+public:
+  explicit TraceRecorder(Telemetry &output);
+
+  void begin(bool enabled);
+  bool enabled() const { return recording; }
+
+  // True color of the objects being presented, COLOR_UNKNOWN if not known
+  void setLabel(Color color) { label = color; }
+
+  // The next record starts a new pick attempt
+  void markCycleStart() { cycleStart = true; }
+
+  void record(uint32_t startUs, uint16_t durationMs, const ColorReading &reading,
+              uint16_t clear, uint8_t scalePercent, uint8_t flags);
+
+private:
+  Telemetry &out;
+  bool recording;
+  bool cycleStart;
+  Color label;
+};
+
+#endif
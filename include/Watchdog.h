@@ -0,0 +1,37 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <Arduino.h>
+#ifdef __AVR__
+#include <avr/wdt.h>
+#endif
+
+// Hardware watchdog. Once armed it has to be fed at least every second; the
+// main loop does that between task runs, so a task stuck in a loop or a wait
+// that never ends resets the board instead of stopping the line.
+//
+// After a watchdog reset the watchdog stays enabled at its shortest timeout,
+// so it is switched off from .init3, before the startup code and
+// constructors can run into it. MCUSR is saved there too.
+void watchdogBegin();
+
+inline void watchdogFeed()
+{
+#ifdef __AVR__
+  wdt_reset();
+#endif
+}
+
+// MCUSR as it was at reset
+uint8_t resetFlags();
+
+inline bool watchdogReset()
+{
+#ifdef __AVR__
+  return resetFlags() & _BV(WDRF);
+#else
+  return false;
+#endif
+}
+
+#endif
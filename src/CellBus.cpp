@@ -0,0 +1,98 @@
+#include "CellBus.h"
+
+CellBus::CellBus()
+    : port(0), ownAddress(0), driverPin(BUS_NO_ENABLE_PIN), requestHandler(0), driving(false), driveStartUs(0),
+      driveUs(0), requests(0)
+{
+}
+
+void CellBus::begin(HardwareSerial &serialPort, uint8_t address, uint8_t enablePin)
+{
+  port = &serialPort;
+  ownAddress = address;
+  driverPin = enablePin;
+  if (driverPin != BUS_NO_ENABLE_PIN)
+  {
+    digitalWrite(driverPin, LOW);
+    pinMode(driverPin, OUTPUT);
+  }
+  port->begin(BUS_BAUD);
+}
+
+void CellBus::update()
+{
+  if (!port)
+  {
+    return;
+  }
+
+  // Let go of the line once the reply has gone out
+  if (driving)
+  {
+    if (micros() - driveStartUs < driveUs)
+    {
+      return;
+    }
+    digitalWrite(driverPin, LOW);
+    driving = false;
+  }
+
+  while (port->available() > 0)
+  {
+    BusMessage message;
+    if (!receiver.push((uint8_t)port->read(), message))
+    {
+      continue;
+    }
+    // Broadcasts are acted on but never answered
+    if (message.destination != ownAddress && message.destination != BUS_BROADCAST)
+    {
+      continue;
+    }
+    if (message.source != BUS_HOST || !requestHandler)
+    {
+      continue;
+    }
+
+    requests++;
+    uint8_t payload[BUS_MAX_PAYLOAD];
+    uint8_t command = 0;
+    uint8_t length = requestHandler(message.command, message.payload, message.payloadLength, payload, command);
+    if (command != 0 && message.destination == ownAddress)
+    {
+      reply(command, payload, length);
+      return;
+    }
+  }
+}
+
+void CellBus::reply(uint8_t command, const uint8_t *payload, uint8_t length)
+{
+  uint8_t frame[BUS_MAX_FRAME];
+  size_t frameLength = busEncode(BUS_HOST, ownAddress, command, payload, length, frame);
+  if (frameLength == 0)
+  {
+    return;
+  }
+
+  // The whole frame fits in the TX buffer, so this doesn't wait. Ten bits a
+  // byte, plus one byte for the one still in the shift register.
+  if (driverPin != BUS_NO_ENABLE_PIN)
+  {
+    digitalWrite(driverPin, HIGH);
+    driving = true;
+    driveStartUs = micros();
+    driveUs = (frameLength + 1) * 10000000UL / BUS_BAUD;
+  }
+  port->write(frame, frameLength);
+}
+
+void CellBus::print(Print &out) const
+{
+  out.print(F("bus: address "));
+  out.print(ownAddress);
+  out.print(F(", requests "));
+  out.print(requests);
+  out.print(F(", bad frames "));
+  out.println(receiver.badFrames);
+}
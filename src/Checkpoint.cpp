@@ -0,0 +1,158 @@
+#include "Checkpoint.h"
+#include <EEPROM.h>
+#ifdef __AVR__
+#include <avr/eeprom.h>
+#endif
+
+Checkpoint::Checkpoint()
+    : baseAddress(0), slots(CHECKPOINT_SLOTS), found(false), nextSlot(0), staged(false), writeIndex(0), writeAddress(0), writing(false)
+{
+  newest.sequence = 0;
+  newest.phase = 0;
+  newest.color = 0;
+  for (uint8_t i = 0; i < SERVO_COUNT; i++)
+  {
+    newest.angles[i] = 0;
+  }
+  pending = newest;
+}
+
+bool Checkpoint::begin(int address, uint8_t slotCount)
+{
+  baseAddress = address;
+  slots = slotCount;
+  found = false;
+
+  // Newest is the valid slot furthest ahead in sequence; the ring never
+  // spans more than slots numbers, so wrap-around compares work
+  uint8_t newestSlot = 0;
+  for (uint8_t slot = 0; slot < slots; slot++)
+  {
+    CheckpointRecord record;
+    if (!readSlot(slot, record))
+    {
+      continue;
+    }
+    if (!found || (int16_t)(record.sequence - newest.sequence) > 0)
+    {
+      newest = record;
+      newestSlot = slot;
+      found = true;
+    }
+  }
+
+  nextSlot = found ? (uint8_t)((newestSlot + 1) % slots) : 0;
+  return found;
+}
+
+void Checkpoint::save(uint8_t phase, uint8_t color, const uint8_t angles[SERVO_COUNT])
+{
+  // Nothing new to write
+  bool same = !staged && found && newest.phase == phase && newest.color == color;
+  for (uint8_t i = 0; same && i < SERVO_COUNT; i++)
+  {
+    same = newest.angles[i] == angles[i];
+  }
+  if (same)
+  {
+    return;
+  }
+
+  // A newer state replaces one that hasn't started writing yet
+  pending.phase = phase;
+  pending.color = color;
+  for (uint8_t i = 0; i < SERVO_COUNT; i++)
+  {
+    pending.angles[i] = angles[i];
+  }
+  staged = true;
+}
+
+void Checkpoint::update()
+{
+#ifdef __AVR__
+  if (!eeprom_is_ready())
+  {
+    return;
+  }
+#endif
+
+  if (!writing)
+  {
+    if (!staged)
+    {
+      return;
+    }
+    staged = false;
+    pending.sequence = found ? (uint16_t)(newest.sequence + 1) : 0;
+    newest = pending;
+    found = true;
+    pack(newest, bytes);
+    writeAddress = baseAddress + nextSlot * CHECKPOINT_RECORD_SIZE;
+    nextSlot = (uint8_t)((nextSlot + 1) % slots);
+    writeIndex = 0;
+    writing = true;
+  }
+
+  // update() skips bytes that haven't changed
+  EEPROM.update(writeAddress + writeIndex, bytes[writeIndex]);
+  if (++writeIndex == CHECKPOINT_RECORD_SIZE)
+  {
+    writing = false;
+  }
+}
+
+// CRC of a slot's bytes before the CRC, preceded by the ring's address and
+// slot count
+uint16_t Checkpoint::crc(const uint8_t *bytes) const
+{
+  uint8_t data[3 + CHECKPOINT_RECORD_SIZE - 2];
+  data[0] = (uint8_t)baseAddress;
+  data[1] = (uint8_t)(baseAddress >> 8);
+  data[2] = slots;
+  for (uint8_t i = 0; i < CHECKPOINT_RECORD_SIZE - 2; i++)
+  {
+    data[3 + i] = bytes[i];
+  }
+  return telemetryCrc16(data, sizeof(data));
+}
+
+void Checkpoint::pack(const CheckpointRecord &record, uint8_t *out) const
+{
+  out[0] = CHECKPOINT_LAYOUT;
+  out[1] = (uint8_t)record.sequence;
+  out[2] = (uint8_t)(record.sequence >> 8);
+  out[3] = record.phase;
+  out[4] = record.color;
+  for (uint8_t i = 0; i < SERVO_COUNT; i++)
+  {
+    out[5 + i] = record.angles[i];
+  }
+  uint16_t check = crc(out);
+  out[CHECKPOINT_RECORD_SIZE - 2] = (uint8_t)check;
+  out[CHECKPOINT_RECORD_SIZE - 1] = (uint8_t)(check >> 8);
+}
+
+bool Checkpoint::readSlot(uint8_t slot, CheckpointRecord &record) const
+{
+  int address = baseAddress + slot * CHECKPOINT_RECORD_SIZE;
+  uint8_t raw[CHECKPOINT_RECORD_SIZE];
+  for (uint8_t i = 0; i < CHECKPOINT_RECORD_SIZE; i++)
+  {
+    raw[i] = EEPROM.read(address + i);
+  }
+  uint16_t stored = (uint16_t)(raw[CHECKPOINT_RECORD_SIZE - 2] | (raw[CHECKPOINT_RECORD_SIZE - 1] << 8));
+  if (raw[0] != CHECKPOINT_LAYOUT || stored != crc(raw))
+  {
+    return false;
+  }
+
+  record.sequence = (uint16_t)(raw[1] | (raw[2] << 8));
+  record.phase = raw[3];
+  record.color = raw[4];
+  for (uint8_t i = 0; i < SERVO_COUNT; i++)
+  {
+    record.angles[i] = raw[5 + i];
+  }
+  return true;
+}
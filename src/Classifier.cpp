@@ -0,0 +1,110 @@
+#include "Classifier.h"
+
+Classification classifyColor(const ColorReading &reading)
+{
+  Classification result;
+  const uint16_t redFreq = reading.red;
+  const uint16_t greenFreq = reading.green;
+  const uint16_t blueFreq = reading.blue;
+
+  // Check if readings are within valid range
+  result.validRed = (redFreq >= CLASSIFIER_MIN_VALID && redFreq <= CLASSIFIER_MAX_VALID);
+  result.validGreen = (greenFreq >= CLASSIFIER_MIN_VALID && greenFreq <= CLASSIFIER_MAX_VALID);
+  result.validBlue = (blueFreq >= CLASSIFIER_MIN_VALID && blueFreq <= CLASSIFIER_MAX_VALID);
+  result.lowest = COLOR_NONE;
+
+  // First check if any readings are valid
+  if (!result.validRed && !result.validGreen && !result.validBlue)
+  {
+    result.color = COLOR_NONE;
+    return result;
+  }
+
+  // Find the minimum frequency among valid readings
+  uint16_t minFreq = 0xFFFF; // Start with high value
+
+  if (result.validRed)
+  {
+    minFreq = redFreq;
+    result.lowest = COLOR_RED;
+  }
+
+  if (result.validGreen && greenFreq < minFreq)
+  {
+    minFreq = greenFreq;
+    result.lowest = COLOR_GREEN;
+  }
+
+  if (result.validBlue && blueFreq < minFreq)
+  {
+    minFreq = blueFreq;
+    result.lowest = COLOR_BLUE;
+  }
+
+  // Now check if the minimum is significantly lower than others
+  bool redDominant = result.validRed && (redFreq == minFreq) &&
+                     (!result.validGreen || redFreq < greenFreq * CLASSIFIER_DOMINANCE) &&
+                     (!result.validBlue || redFreq < blueFreq * CLASSIFIER_DOMINANCE);
+
+  bool greenDominant = result.validGreen && (greenFreq == minFreq) &&
+                       (!result.validRed || greenFreq < redFreq * CLASSIFIER_DOMINANCE) &&
+                       (!result.validBlue || greenFreq < blueFreq * CLASSIFIER_DOMINANCE);
+
+  bool blueDominant = result.validBlue && (blueFreq == minFreq) &&
+                      (!result.validRed || blueFreq < redFreq * CLASSIFIER_DOMINANCE) &&
+                      (!result.validGreen || blueFreq < greenFreq * CLASSIFIER_DOMINANCE);
+
+  if (redDominant)
+  {
+    result.color = COLOR_RED;
+  }
+  else if (greenDominant)
+  {
+    result.color = COLOR_GREEN;
+  }
+  else if (blueDominant)
+  {
+    result.color = COLOR_BLUE;
+  }
+  else
+  {
+    result.color = COLOR_UNKNOWN;
+  }
+  return result;
+}
+
+Classification classifyLowest(const ColorReading &reading, uint16_t limit)
+{
+  Classification result;
+  result.validRed = (reading.red >= CLASSIFIER_MIN_VALID && reading.red <= CLASSIFIER_MAX_VALID);
+  result.validGreen = (reading.green >= CLASSIFIER_MIN_VALID && reading.green <= CLASSIFIER_MAX_VALID);
+  result.validBlue = (reading.blue >= CLASSIFIER_MIN_VALID && reading.blue <= CLASSIFIER_MAX_VALID);
+  result.lowest = COLOR_NONE;
+
+  if (!result.validRed && !result.validGreen && !result.validBlue)
+  {
+    result.color = COLOR_NONE;
+    return result;
+  }
+
+  // A tie for the shortest pulse leaves lowest at COLOR_NONE
+  uint16_t shortest = 0;
+  if (reading.red < reading.green && reading.red < reading.blue)
+  {
+    result.lowest = COLOR_RED;
+    shortest = reading.red;
+  }
+  else if (reading.green < reading.red && reading.green < reading.blue)
+  {
+    result.lowest = COLOR_GREEN;
+    shortest = reading.green;
+  }
+  else if (reading.blue < reading.red && reading.blue < reading.green)
+  {
+    result.lowest = COLOR_BLUE;
+    shortest = reading.blue;
+  }
+
+  result.color = (result.lowest != COLOR_NONE && shortest < limit) ? result.lowest : COLOR_UNKNOWN;
+  return result;
+}
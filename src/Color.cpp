@@ -0,0 +1,25 @@
+#include "Color.h"
+#include <Arduino.h>
+
+static const char colorNameUnknown[] PROGMEM = "unknown";
+static const char colorNameRed[] PROGMEM = "red";
+static const char colorNameGreen[] PROGMEM = "green";
+static const char colorNameBlue[] PROGMEM = "blue";
+static const char colorNameNone[] PROGMEM = "none";
+
+// Indexed by Color
+static const char *const colorNames[] PROGMEM = {
+    colorNameUnknown,
+    colorNameRed,
+    colorNameGreen,
+    colorNameBlue,
+    colorNameNone};
+
+const __FlashStringHelper *colorName(Color color)
+{
+  if (color > COLOR_NONE)
+  {
+    color = COLOR_UNKNOWN;
+  }
+  return reinterpret_cast<const __FlashStringHelper *>(pgm_read_ptr(&colorNames[color]));
+}
@@ -0,0 +1,174 @@
+#include "ColorSensor.h"
+
+ColorSensor::ColorSensor(uint8_t s0Pin, uint8_t s1Pin, uint8_t s2Pin, uint8_t s3Pin, uint8_t outPin)
+    : s0(s0Pin), s1(s1Pin), s2(s2Pin), s3(s3Pin), out(outPin),
+      autoRanging(false), slowest(SENSOR_READING_MAX), currentScale(SCALE_20_PERCENT), selectedAtMs(0)
+{
+}
+
+void ColorSensor::begin(bool autoRange, unsigned int slowestReading)
+{
+  // Set color sensor pins as OUTPUT
+  pinMode(s0, OUTPUT);
+  pinMode(s1, OUTPUT);
+  pinMode(s2, OUTPUT);
+  pinMode(s3, OUTPUT);
+
+  // Set sensor OUT pin as INPUT
+  pinMode(out, INPUT);
+
+  autoRanging = autoRange;
+  slowest = slowestReading;
+  applyScale(SCALE_20_PERCENT);
+}
+
+void ColorSensor::finishReading(SensorStatus status, const ColorReading &reading)
+{
+  if (status != SENSOR_OK)
+  {
+    // Most likely too dark for this range (or nothing connected); try the
+    // fastest range next time
+    if (autoRanging)
+    {
+      applyScale(SCALE_100_PERCENT);
+    }
+    return;
+  }
+
+  // Pick the scaling for the next reading
+  adjustRange(min(reading.red, min(reading.green, reading.blue)),
+              max(reading.red, max(reading.green, reading.blue)));
+}
+
+void ColorSensor::select(SensorChannel channel)
+{
+  switch (channel)
+  {
+  case CHANNEL_RED:
+    selectFilter(LOW, LOW);
+    break;
+  case CHANNEL_GREEN:
+    selectFilter(HIGH, HIGH);
+    break;
+  case CHANNEL_BLUE:
+    selectFilter(LOW, HIGH);
+    break;
+  case CHANNEL_CLEAR:
+    selectFilter(HIGH, LOW);
+    break;
+  }
+}
+
+bool ColorSensor::settled() const
+{
+  return millis() - selectedAtMs >= SENSOR_SETTLE_MS;
+}
+
+uint8_t ColorSensor::scalePercent() const
+{
+  return percentFor(currentScale);
+}
+
+unsigned long ColorSensor::channelTimeoutUs() const
+{
+  // pulseIn may have to wait out the current LOW pulse and the HIGH half
+  // before timing the next LOW pulse, so allow three half-periods
+  unsigned long slowestUs = (unsigned long)slowest * 2 / percentFor(currentScale);
+  return slowestUs * 3 + 100;
+}
+
+void ColorSensor::selectFilter(uint8_t s2Level, uint8_t s3Level)
+{
+  digitalWrite(s2, s2Level);
+  digitalWrite(s3, s3Level);
+  selectedAtMs = millis();
+}
+
+SensorStatus ColorSensor::measure(uint16_t &value)
+{
+  unsigned long pulseUs = pulseIn(out, LOW, channelTimeoutUs());
+  if (pulseUs == 0)
+  {
+    return SENSOR_TIMEOUT;
+  }
+
+  // Rescale to 0.1us at 20% scaling
+  unsigned long reading = pulseUs * percentFor(currentScale) / 2;
+  if (reading > SENSOR_READING_MAX)
+  {
+    reading = SENSOR_READING_MAX;
+  }
+  value = (uint16_t)reading;
+  return SENSOR_OK;
+}
+
+void ColorSensor::adjustRange(unsigned int shortest, unsigned int longest)
+{
+  if (!autoRanging)
+  {
+    return;
+  }
+
+  // Try the fastest range first. Readings are in 0.1us at 20%, so the pulse
+  // at a given scaling is reading * 2 / percent microseconds.
+  const SensorScale candidates[] = {SCALE_100_PERCENT, SCALE_20_PERCENT, SCALE_2_PERCENT};
+  const uint8_t candidateCount = sizeof(candidates) / sizeof(candidates[0]);
+  SensorScale chosen = candidates[candidateCount - 1];
+
+  for (uint8_t i = 0; i + 1 < candidateCount; i++)
+  {
+    unsigned long shortUs = (unsigned long)shortest * 2 / percentFor(candidates[i]);
+    if (shortUs >= SENSOR_MIN_COUNTS)
+    {
+      chosen = candidates[i];
+      break;
+    }
+
+    // Not enough resolution here, but only slow down if the next range
+    // still fits in the time budget
+    unsigned long nextLongUs = (unsigned long)longest * 2 / percentFor(candidates[i + 1]);
+    if (nextLongUs > SENSOR_READ_BUDGET_US)
+    {
+      chosen = candidates[i];
+      break;
+    }
+  }
+
+  if (chosen != currentScale)
+  {
+    applyScale(chosen);
+  }
+}
+
+void ColorSensor::applyScale(SensorScale newScale)
+{
+  switch (newScale)
+  {
+  case SCALE_2_PERCENT:
+    digitalWrite(s0, LOW);
+    digitalWrite(s1, HIGH);
+    break;
+  case SCALE_20_PERCENT:
+    digitalWrite(s0, HIGH);
+    digitalWrite(s1, LOW);
+    break;
+  case SCALE_100_PERCENT:
+    digitalWrite(s0, HIGH);
+    digitalWrite(s1, HIGH);
+    break;
+  }
+  currentScale = newScale;
+}
+
+uint8_t ColorSensor::percentFor(SensorScale s)
+{
+  switch (s)
+  {
+  case SCALE_2_PERCENT:
+    return 2;
+  case SCALE_100_PERCENT:
+    return 100;
+  default:
+    return 20;
+  }
+}
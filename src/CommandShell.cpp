@@ -0,0 +1,259 @@
+#include "CommandShell.h"
+#include <EEPROM.h>
+#ifdef __AVR__
+#include <avr/eeprom.h>
+#endif
+
+CommandShell::CommandShell(Stream &input, Print &output, const ParamInfo *params, uint8_t paramCount)
+    : in(input), out(output), table(params), count(paramCount), extraCommands(0), length(0), busy(false),
+      savePending(false), saveOffset(0), saveSum(0)
+{
+}
+
+void CommandShell::poll()
+{
+  // A command can end up in delay() and so back in here through yield()
+  if (busy)
+  {
+    return;
+  }
+  busy = true;
+
+  while (in.available() > 0)
+  {
+    char c = (char)in.read();
+    if (c == '\r')
+    {
+      continue;
+    }
+
+    if (c != '\n')
+    {
+      if (length < sizeof(line) - 1)
+      {
+        line[length++] = c;
+      }
+      continue;
+    }
+
+    line[length] = '\0';
+    length = 0;
+    execute(line);
+  }
+
+  busy = false;
+}
+
+bool CommandShell::load()
+{
+  int address = PARAMS_EEPROM_ADDRESS;
+  uint16_t magic = EEPROM.read(address) | (EEPROM.read(address + 1) << 8);
+  if (magic != PARAMS_EEPROM_MAGIC || EEPROM.read(address + 2) != count)
+  {
+    return false;
+  }
+
+  // Check everything before touching any parameter
+  uint8_t sum = 0;
+  for (uint16_t i = 0; i < (uint16_t)count * 2; i++)
+  {
+    sum += EEPROM.read(address + 3 + i);
+  }
+  if ((uint8_t)(sum + EEPROM.read(address + 3 + count * 2)) != 0)
+  {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    ParamInfo info;
+    readParam(i, info);
+    int value = (int)(EEPROM.read(address + 3 + i * 2) | (EEPROM.read(address + 4 + i * 2) << 8));
+    *info.value = constrain(value, info.minValue, info.maxValue);
+  }
+  return true;
+}
+
+void CommandShell::save()
+{
+  // Starting over also covers a parameter set while a save was under way
+  savePending = true;
+  saveOffset = 0;
+  saveSum = 0;
+}
+
+void CommandShell::update()
+{
+  if (!savePending)
+  {
+    return;
+  }
+#ifdef __AVR__
+  if (!eeprom_is_ready())
+  {
+    return;
+  }
+#endif
+
+  // Bytes that haven't changed are skipped, which saves EEPROM wear; at
+  // most one is written per call
+  uint16_t size = eepromSize();
+  while (saveOffset < size)
+  {
+    uint8_t value = savedByte(saveOffset);
+    int address = PARAMS_EEPROM_ADDRESS + saveOffset;
+    if (saveOffset >= 3 && saveOffset < size - 1)
+    {
+      saveSum += value;
+    }
+    saveOffset++;
+    if (EEPROM.read(address) != value)
+    {
+      EEPROM.write(address, value);
+      break;
+    }
+  }
+  if (saveOffset == size)
+  {
+    savePending = false;
+    out.println(F("saved"));
+  }
+}
+
+// Function to get one byte of the saved layout: magic, count, each value
+// little-endian, then the checksum of the values written before it
+uint8_t CommandShell::savedByte(uint16_t offset) const
+{
+  if (offset < 2)
+  {
+    return (uint8_t)(PARAMS_EEPROM_MAGIC >> (8 * offset));
+  }
+  if (offset == 2)
+  {
+    return count;
+  }
+  if (offset == eepromSize() - 1)
+  {
+    return (uint8_t)(0 - saveSum);
+  }
+  ParamInfo info;
+  readParam((uint8_t)((offset - 3) / 2), info);
+  return (uint8_t)(*info.value >> (8 * ((offset - 3) % 2)));
+}
+
+uint16_t CommandShell::eepromSize() const
+{
+  return 3 + count * 2 + 1;
+}
+
+void CommandShell::execute(char *text)
+{
+  char *command = strtok(text, " ");
+  if (!command)
+  {
+    return;
+  }
+  char *args = strtok(0, "");
+
+  if (strcmp_P(command, PSTR("get")) == 0)
+  {
+    char *name = args ? strtok(args, " ") : 0;
+    if (!name)
+    {
+      for (uint8_t i = 0; i < count; i++)
+      {
+        printParam(i);
+      }
+      return;
+    }
+    int index = find(name);
+    if (index < 0)
+    {
+      out.print(F("unknown parameter "));
+      out.println(name);
+      return;
+    }
+    printParam(index);
+  }
+  else if (strcmp_P(command, PSTR("set")) == 0)
+  {
+    char *name = args ? strtok(args, " ") : 0;
+    char *value = name ? strtok(0, " ") : 0;
+    if (!value)
+    {
+      out.println(F("usage: set name value"));
+      return;
+    }
+    int index = find(name);
+    if (index < 0)
+    {
+      out.print(F("unknown parameter "));
+      out.println(name);
+      return;
+    }
+
+    ParamInfo info;
+    readParam(index, info);
+    char *end;
+    long parsed = strtol(value, &end, 10);
+    if (*end != '\0' || parsed < info.minValue || parsed > info.maxValue)
+    {
+      out.print(F("out of range "));
+      out.print(info.minValue);
+      out.print(F(".."));
+      out.println(info.maxValue);
+      return;
+    }
+    *info.value = (int)parsed;
+    printParam(index);
+    if (savePending)
+    {
+      save();
+    }
+  }
+  else if (strcmp_P(command, PSTR("save")) == 0)
+  {
+    save();
+    out.println(F("saving"));
+  }
+  else if (strcmp_P(command, PSTR("load")) == 0)
+  {
+    if (savePending)
+    {
+      out.println(F("still saving"));
+      return;
+    }
+    out.println(load() ? F("loaded") : F("nothing saved"));
+  }
+  else if (!extraCommands || !extraCommands(command, args, out))
+  {
+    out.print(F("unknown command "));
+    out.println(command);
+  }
+}
+
+int CommandShell::find(const char *name) const
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (strcmp_P(name, table[i].name) == 0)
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+void CommandShell::printParam(uint8_t index)
+{
+  ParamInfo info;
+  readParam(index, info);
+  out.print(info.name);
+  out.print('=');
+  out.println(*info.value);
+}
+
+void CommandShell::readParam(uint8_t index, ParamInfo &info) const
+{
+  memcpy_P(&info, &table[index], sizeof(ParamInfo));
+}
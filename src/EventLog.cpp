@@ -0,0 +1,75 @@
+#include "EventLog.h"
+
+void EventLog::begin(uint8_t resetCause)
+{
+  // After power-up the section holds garbage; checking the magic and the
+  // indices is enough to tell
+  if (magic != EVENT_LOG_MAGIC || next >= EVENT_LOG_SIZE || used > EVENT_LOG_SIZE)
+  {
+    bootCount = 0;
+    clear();
+  }
+  bootCount++;
+  record(EV_BOOT, micros(), &resetCause, 1);
+}
+
+void EventLog::clear()
+{
+  magic = EVENT_LOG_MAGIC;
+  next = 0;
+  used = 0;
+}
+
+void EventLog::record(TelemetryEvent event, uint32_t timeUs, const uint8_t *payload, uint8_t length)
+{
+  switch (event)
+  {
+  case EV_TEXT:
+  case EV_TRACE:
+  case EV_STATS:
+  case EV_DROPPED:
+  case EV_DWELL_START:
+  case EV_DWELL_END:
+  case EV_MOVE_START:
+    return;
+  default:
+    break;
+  }
+
+  EventLogEntry &e = entries[next];
+  e.timeUs = timeUs;
+  e.event = event;
+  for (uint8_t i = 0; i < sizeof(e.data); i++)
+  {
+    e.data[i] = i < length ? payload[i] : 0;
+  }
+
+  next = (next + 1) % EVENT_LOG_SIZE;
+  if (used < EVENT_LOG_SIZE)
+  {
+    used++;
+  }
+}
+
+const EventLogEntry &EventLog::entry(uint8_t index) const
+{
+  uint8_t oldest = (next + EVENT_LOG_SIZE - used) % EVENT_LOG_SIZE;
+  return entries[(oldest + index) % EVENT_LOG_SIZE];
+}
+
+// One line per entry: index, micros(), event id and data bytes in hex
+void EventLog::printEntry(Print &out, uint8_t index) const
+{
+  const EventLogEntry &e = entry(index);
+  out.print(index);
+  out.print(' ');
+  out.print(e.timeUs);
+  out.print(F(" 0x"));
+  out.print(e.event, HEX);
+  for (uint8_t i = 0; i < sizeof(e.data); i++)
+  {
+    out.print(' ');
+    out.print(e.data[i], HEX);
+  }
+  out.println();
+}
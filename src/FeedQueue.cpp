@@ -0,0 +1,66 @@
+#include "FeedQueue.h"
+
+FeedQueue::FeedQueue() : head(0), used(0), overflows(0)
+{
+}
+
+bool FeedQueue::push(Color color, unsigned long sensedMs, unsigned long travelMs)
+{
+  if (used == FEED_QUEUE_SIZE)
+  {
+    overflows++;
+    return false;
+  }
+  FeedObject &object = entries[(head + used) % FEED_QUEUE_SIZE];
+  object.color = color;
+  object.sensedMs = sensedMs;
+  object.arrivalMs = sensedMs + travelMs;
+  used++;
+  return true;
+}
+
+unsigned long FeedQueue::msUntilArrival() const
+{
+  long left = (long)(entries[head].arrivalMs - millis());
+  return left > 0 ? (unsigned long)left : 0;
+}
+
+void FeedQueue::pop()
+{
+  if (used == 0)
+  {
+    return;
+  }
+  head = (head + 1) % FEED_QUEUE_SIZE;
+  used--;
+}
+
+void FeedQueue::clear()
+{
+  head = 0;
+  used = 0;
+}
+
+// One line per object, oldest first: color, age and time left to arrival
+void FeedQueue::print(Print &out) const
+{
+  unsigned long now = millis();
+  out.print(F("feed: "));
+  out.print(used);
+  out.print(F(" queued, "));
+  out.print(overflows);
+  out.println(F(" dropped"));
+  for (uint8_t i = 0; i < used; i++)
+  {
+    const FeedObject &object = entries[(head + i) % FEED_QUEUE_SIZE];
+    long left = (long)(object.arrivalMs - now);
+    out.print(i);
+    out.print(F(": "));
+    out.print(colorName(object.color));
+    out.print(F(", sensed "));
+    out.print(now - object.sensedMs);
+    out.print(F(" ms ago, arrives in "));
+    out.print(left > 0 ? left : 0);
+    out.println(F(" ms"));
+  }
+}
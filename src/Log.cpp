@@ -0,0 +1,13 @@
+#include "Log.h"
+
+static Print *logSink = 0;
+
+void logBegin(Print &out)
+{
+  logSink = &out;
+}
+
+Print *logOutput()
+{
+  return logSink;
+}
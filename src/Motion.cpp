@@ -0,0 +1,147 @@
+#include "Motion.h"
+#include "JointLimits.h"
+#include "Log.h"
+
+Motion::Motion(ArmServo *const servos[SERVO_COUNT], Telemetry &telemetry) : out(telemetry), poseChanged(false)
+{
+  for (uint8_t i = 0; i < SERVO_COUNT; i++)
+  {
+    joints[i].servo = servos[i];
+    // Where the Servo library puts a servo attached without a write, or
+    // the nearest safe angle to it
+    joints[i].angle = clampToLimits(i, 90);
+    joints[i].start = joints[i].angle;
+    joints[i].target = joints[i].angle;
+    joints[i].msPerDegree = 0;
+    joints[i].rampDegrees = 0;
+    joints[i].lastStepMs = 0;
+    joints[i].clamped = 0;
+    joints[i].moving = false;
+  }
+}
+
+void Motion::moveTo(uint8_t joint, int to, uint8_t msPerDegree, uint8_t rampDegrees)
+{
+  Joint &j = joints[joint];
+  to = limit(joint, to);
+  uint8_t payload[4] = {joint, (uint8_t)j.angle, (uint8_t)to, msPerDegree};
+  out.send(EV_MOVE_START, payload, sizeof(payload));
+
+  j.start = j.angle;
+  j.target = to;
+  j.msPerDegree = msPerDegree;
+  j.rampDegrees = rampDegrees;
+  j.lastStepMs = millis();
+  j.moving = true;
+  j.servo->write(j.angle);
+  poseChanged = true;
+}
+
+void Motion::jumpTo(uint8_t joint, int angle)
+{
+  Joint &j = joints[joint];
+  angle = limit(joint, angle);
+  j.angle = angle;
+  j.target = angle;
+  j.servo->write(angle);
+  if (j.moving)
+  {
+    finish(joint);
+  }
+  poseChanged = true;
+}
+
+int Motion::velocity(uint8_t joint) const
+{
+  const Joint &j = joints[joint];
+  if (!j.moving || j.angle == j.target)
+  {
+    return 0;
+  }
+  unsigned long ms = stepMs(j);
+  int speed = ms ? (int)(1000 / ms) : 1000;
+  return (j.target > j.angle) ? speed : -speed;
+}
+
+void Motion::stop(uint8_t joint)
+{
+  if (joints[joint].moving)
+  {
+    finish(joint);
+    poseChanged = true;
+  }
+}
+
+bool Motion::idle() const
+{
+  for (uint8_t i = 0; i < SERVO_COUNT; i++)
+  {
+    if (joints[i].moving)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Motion::update()
+{
+  unsigned long now = millis();
+  bool wrote = false;
+
+  for (uint8_t i = 0; i < SERVO_COUNT; i++)
+  {
+    Joint &j = joints[i];
+    if (!j.moving)
+    {
+      continue;
+    }
+    unsigned long interval = stepMs(j);
+    if (now - j.lastStepMs < interval)
+    {
+      continue;
+    }
+
+    if (j.angle == j.target)
+    {
+      finish(i);
+      continue;
+    }
+
+    j.angle += (j.target > j.angle) ? 1 : -1;
+    // Keep the pace steady, but don't rush to catch up after a late update
+    j.lastStepMs = (now - j.lastStepMs >= 2UL * interval) ? now : j.lastStepMs + interval;
+    j.servo->write(j.angle);
+    wrote = true;
+  }
+  return wrote;
+}
+
+// Function to keep a target inside the joint's travel
+int Motion::limit(uint8_t joint, int angle)
+{
+  int safe = clampToLimits(joint, angle);
+  if (safe != angle)
+  {
+    joints[joint].clamped++;
+    LOG_WARN(F("Servo "), joint, F(" target "), angle, F(" clamped to "), safe);
+  }
+  return safe;
+}
+
+void Motion::finish(uint8_t joint)
+{
+  joints[joint].moving = false;
+  out.send(EV_MOVE_END, joint, (uint8_t)joints[joint].angle);
+}
+
+// Function to get how long the joint holds its current degree
+unsigned long Motion::stepMs(const Joint &j)
+{
+  if (j.rampDegrees != 0 &&
+      (abs(j.angle - j.start) < j.rampDegrees || abs(j.target - j.angle) < j.rampDegrees))
+  {
+    return 2UL * j.msPerDegree;
+  }
+  return j.msPerDegree;
+}
@@ -0,0 +1,180 @@
+#include "ServoBackend.h"
+
+#if SERVO_BACKEND == SERVO_BACKEND_PCA9685
+
+// Servo library defaults, so angles map to the same pulses as before
+static const int SERVO_MIN_PULSE_US = 544;
+static const int SERVO_MAX_PULSE_US = 2400;
+
+Pca9685 servoController(Wire);
+
+Pca9685::Pca9685(TwoWire &bus, uint8_t i2cAddress)
+    : wire(bus), address(i2cAddress), prescale(121), dirty(0), sentBytes(0), sentBursts(0)
+{
+  for (uint8_t i = 0; i < PCA9685_CHANNELS; i++)
+  {
+    // Spread the pulse starts over the frame
+    onTicks[i] = (uint16_t)i * (4096 / PCA9685_CHANNELS);
+    offTicks[i] = (uint16_t)PCA9685_FULL_OFF << 8;
+  }
+}
+
+bool Pca9685::begin(uint8_t frameHz)
+{
+  wire.begin();
+  wire.setClock(400000);
+
+  // The prescaler can only be changed while the oscillator sleeps
+  prescale = (uint8_t)((PCA9685_OSCILLATOR_HZ + 2048UL * frameHz) / (4096UL * frameHz) - 1);
+  if (!writeRegister(PCA9685_MODE1, PCA9685_MODE1_SLEEP | PCA9685_MODE1_AI) ||
+      !writeRegister(PCA9685_PRE_SCALE, prescale) ||
+      !writeRegister(PCA9685_MODE1, PCA9685_MODE1_AI))
+  {
+    return false;
+  }
+
+  // Oscillator start-up time, then restart any PWM that was running
+  delayMicroseconds(500);
+  if (!writeRegister(PCA9685_MODE1, PCA9685_MODE1_RESTART | PCA9685_MODE1_AI))
+  {
+    return false;
+  }
+
+  // Everything starts off until attached
+  dirty = 0xFFFF;
+  return flush();
+}
+
+void Pca9685::setPulse(uint8_t channel, unsigned int pulseUs)
+{
+  if (channel >= PCA9685_CHANNELS)
+  {
+    return;
+  }
+
+  // One tick is (prescale + 1) oscillator cycles
+  unsigned long ticks = (unsigned long)pulseUs * (PCA9685_OSCILLATOR_HZ / 1000000UL) / (prescale + 1);
+  uint16_t off = (uint16_t)((onTicks[channel] + ticks) % 4096);
+  if (off != offTicks[channel])
+  {
+    offTicks[channel] = off;
+    dirty |= (uint16_t)1 << channel;
+  }
+}
+
+void Pca9685::setOff(uint8_t channel)
+{
+  uint16_t off = (uint16_t)PCA9685_FULL_OFF << 8;
+  if (channel < PCA9685_CHANNELS && offTicks[channel] != off)
+  {
+    offTicks[channel] = off;
+    dirty |= (uint16_t)1 << channel;
+  }
+}
+
+bool Pca9685::flush()
+{
+  if (!dirty)
+  {
+    return true;
+  }
+
+  uint8_t first = 0;
+  while (!(dirty & ((uint16_t)1 << first)))
+  {
+    first++;
+  }
+  uint8_t last = PCA9685_CHANNELS - 1;
+  while (!(dirty & ((uint16_t)1 << last)))
+  {
+    last--;
+  }
+
+  // Unchanged channels in between are rewritten with the same values;
+  // that is cheaper than starting another transaction
+  for (uint8_t start = first; start <= last; start += PCA9685_CHANNELS_PER_BURST)
+  {
+    uint8_t end = min((uint8_t)(start + PCA9685_CHANNELS_PER_BURST - 1), last);
+    if (!writeChannels(start, end))
+    {
+      return false;
+    }
+    for (uint8_t i = start; i <= end; i++)
+    {
+      dirty &= ~((uint16_t)1 << i);
+    }
+  }
+  return true;
+}
+
+bool Pca9685::writeRegister(uint8_t reg, uint8_t value)
+{
+  wire.beginTransmission(address);
+  wire.write(reg);
+  wire.write(value);
+  return wire.endTransmission() == 0;
+}
+
+bool Pca9685::writeChannels(uint8_t first, uint8_t last)
+{
+  wire.beginTransmission(address);
+  wire.write((uint8_t)(PCA9685_LED0_ON_L + 4 * first));
+  for (uint8_t i = first; i <= last; i++)
+  {
+    wire.write((uint8_t)onTicks[i]);
+    wire.write((uint8_t)(onTicks[i] >> 8));
+    wire.write((uint8_t)offTicks[i]);
+    wire.write((uint8_t)(offTicks[i] >> 8));
+  }
+  sentBytes += 1 + 4 * (last - first + 1);
+  sentBursts++;
+  return wire.endTransmission() == 0;
+}
+
+Pca9685 *Pca9685Servo::pca = 0;
+
+Pca9685Servo::Pca9685Servo()
+    : channel(0), minPulseUs(SERVO_MIN_PULSE_US), maxPulseUs(SERVO_MAX_PULSE_US), angle(90), isAttached(false)
+{
+}
+
+uint8_t Pca9685Servo::attach(int servoChannel)
+{
+  return attach(servoChannel, SERVO_MIN_PULSE_US, SERVO_MAX_PULSE_US);
+}
+
+uint8_t Pca9685Servo::attach(int servoChannel, int minUs, int maxUs)
+{
+  channel = (uint8_t)servoChannel;
+  minPulseUs = minUs;
+  maxPulseUs = maxUs;
+  isAttached = true;
+  // Like the Servo library, resume at the last angle written
+  write(angle);
+  return channel;
+}
+
+void Pca9685Servo::detach()
+{
+  isAttached = false;
+  if (pca)
+  {
+    pca->setOff(channel);
+  }
+}
+
+void Pca9685Servo::write(int newAngle)
+{
+  angle = constrain(newAngle, 0, 180);
+  writeMicroseconds(map(angle, 0, 180, minPulseUs, maxPulseUs));
+}
+
+void Pca9685Servo::writeMicroseconds(int pulseUs)
+{
+  if (isAttached && pca)
+  {
+    pca->setPulse(channel, (unsigned int)constrain(pulseUs, minPulseUs, maxPulseUs));
+  }
+}
+
+#endif
@@ -0,0 +1,234 @@
+#include "PerfCounters.h"
+
+#ifdef __AVR__
+#include <util/atomic.h>
+
+// Bytes between the end of static data and the top of RAM are painted with
+// this before anything runs, so the lowest unpainted byte marks how deep the
+// stack has ever gone
+static const uint8_t STACK_PAINT = 0xC5;
+
+extern uint8_t _end;
+extern uint8_t __stack;
+
+// Runs from .init3, after the stack pointer is set up and before any
+// constructors, and uses no stack itself
+void paintStack() __attribute__((naked, used, section(".init3")));
+void paintStack()
+{
+  uint8_t *p = &_end;
+  while (p <= &__stack)
+  {
+    *p++ = STACK_PAINT;
+  }
+}
+#endif
+
+PerfCounters::PerfCounters()
+{
+  reset();
+}
+
+void PerfCounters::reset()
+{
+  lastLoopUs = 0;
+  loopMin = 0xFFFFFFFFUL;
+  loopMax = 0;
+  blockingTotalUs = 0;
+  longestBlock = 0;
+  blockingDepth = 0;
+  inMotion = false;
+  maxMotionGap = 0;
+  isrUs = 0;
+}
+
+void PerfCounters::loopTick()
+{
+  uint32_t now = micros();
+  if (lastLoopUs != 0)
+  {
+    uint32_t period = now - lastLoopUs;
+    if (period < loopMin)
+    {
+      loopMin = period;
+    }
+    if (period > loopMax)
+    {
+      loopMax = period;
+    }
+  }
+  lastLoopUs = now;
+}
+
+void PerfCounters::blockingBegin()
+{
+  // Only the outermost call counts, so nested delays aren't added twice
+  if (blockingDepth++ == 0)
+  {
+    blockingStartUs = micros();
+  }
+}
+
+void PerfCounters::blockingEnd()
+{
+  if (blockingDepth == 0 || --blockingDepth != 0)
+  {
+    return;
+  }
+  uint32_t spent = micros() - blockingStartUs;
+  blockingTotalUs += spent;
+  if (spent > longestBlock)
+  {
+    longestBlock = spent;
+  }
+}
+
+void PerfCounters::motionBegin()
+{
+  inMotion = true;
+  lastMotionUs = micros();
+}
+
+void PerfCounters::motionUpdate()
+{
+  uint32_t now = micros();
+  if (inMotion && now - lastMotionUs > maxMotionGap)
+  {
+    maxMotionGap = now - lastMotionUs;
+  }
+  lastMotionUs = now;
+}
+
+void PerfCounters::measureIsrLoad()
+{
+#if defined(__AVR__) && defined(TCNT5)
+  // Timer5 counts 0.5us ticks and starts over every 20 ms frame: the
+  // Servo ISR resets it, and the timer PWM backend runs it with a 20 ms
+  // TOP. Nothing runs it with the PCA9685 backend.
+  if (!(TCCR5B & ((1 << CS52) | (1 << CS51) | (1 << CS50))))
+  {
+    return;
+  }
+
+  uint16_t previous;
+  uint16_t now;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { previous = TCNT5; }
+
+  // Wait for the start of a frame (bounded in case the timer stops)
+  uint32_t waitStart = micros();
+  for (;;)
+  {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { now = TCNT5; }
+    if (now < previous || micros() - waitStart > 25000UL)
+    {
+      break;
+    }
+    previous = now;
+  }
+
+  // Poll through one frame. Without interrupts every poll would take the
+  // same few ticks; anything beyond the fastest poll was spent in an ISR.
+  uint32_t elapsed = 0;
+  uint32_t polls = 0;
+  uint16_t fastest = 0xFFFF;
+  previous = now;
+  for (;;)
+  {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) { now = TCNT5; }
+    if (now < previous)
+    {
+      break;
+    }
+    uint16_t delta = now - previous;
+    elapsed += delta;
+    polls++;
+    if (delta < fastest)
+    {
+      fastest = delta;
+    }
+    previous = now;
+    if (elapsed > 50000UL)
+    {
+      break;
+    }
+  }
+
+  uint32_t stolenTicks = elapsed - polls * (uint32_t)fastest;
+  isrUs = (uint16_t)(stolenTicks / 2);
+#endif
+}
+
+uint16_t PerfCounters::stackUsed() const
+{
+#ifdef __AVR__
+  const uint8_t *p = &_end;
+  while (p <= &__stack && *p == STACK_PAINT)
+  {
+    p++;
+  }
+  return (uint16_t)(&__stack - p + 1);
+#else
+  return 0;
+#endif
+}
+
+uint16_t PerfCounters::minFreeRam() const
+{
+#ifdef __AVR__
+  // There is no heap (see the noheap build), so free RAM is everything
+  // between the end of static data and the deepest point of the stack
+  return (uint16_t)(&__stack - &_end + 1) - stackUsed();
+#else
+  return 0;
+#endif
+}
+
+void PerfCounters::print(Print &out) const
+{
+  out.print(F("loop us min/max: "));
+  out.print(loopMin == 0xFFFFFFFFUL ? 0 : loopMin);
+  out.print('/');
+  out.println(loopMax);
+  out.print(F("blocking ms total: "));
+  out.print(blockingMs());
+  out.print(F(", longest us: "));
+  out.println(longestBlock);
+  out.print(F("max motion gap us: "));
+  out.println(maxMotionGap);
+  out.print(F("isr us per frame: "));
+  out.println(isrUs);
+  out.print(F("stack used: "));
+  out.print(stackUsed());
+  out.print(F(", min free ram: "));
+  out.println(minFreeRam());
+}
+
+static uint8_t put32(uint8_t *p, uint32_t value)
+{
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+  return 4;
+}
+
+static uint8_t put16(uint8_t *p, uint16_t value)
+{
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  return 2;
+}
+
+uint8_t PerfCounters::pack(uint8_t *payload) const
+{
+  uint8_t n = 0;
+  n += put32(payload + n, loopMin == 0xFFFFFFFFUL ? 0 : loopMin);
+  n += put32(payload + n, loopMax);
+  n += put32(payload + n, blockingMs());
+  n += put32(payload + n, longestBlock);
+  n += put32(payload + n, maxMotionGap);
+  n += put16(payload + n, isrUs);
+  n += put16(payload + n, stackUsed());
+  n += put16(payload + n, minFreeRam());
+  return n;
+}
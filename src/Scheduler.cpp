@@ -0,0 +1,114 @@
+#include "Scheduler.h"
+
+Scheduler::Scheduler() : taskCount(0)
+{
+}
+
+int8_t Scheduler::add(const __FlashStringHelper *name, TaskFunction run, uint32_t periodUs,
+                      uint32_t deadlineUs, uint8_t priority)
+{
+  if (taskCount >= SCHEDULER_MAX_TASKS)
+  {
+    return -1;
+  }
+
+  Task &t = tasks[taskCount];
+  t.name = name;
+  t.run = run;
+  t.periodUs = periodUs;
+  t.deadlineUs = deadlineUs;
+  t.priority = priority;
+  t.releaseUs = micros();
+  return (int8_t)taskCount++;
+}
+
+void Scheduler::begin()
+{
+  uint32_t now = micros();
+  for (uint8_t i = 0; i < taskCount; i++)
+  {
+    tasks[i].releaseUs = now;
+  }
+  resetStats();
+}
+
+void Scheduler::resetStats()
+{
+  for (uint8_t i = 0; i < taskCount; i++)
+  {
+    tasks[i].runs = 0;
+    tasks[i].misses = 0;
+    tasks[i].maxLatencyUs = 0;
+    tasks[i].maxRunUs = 0;
+  }
+}
+
+bool Scheduler::runOnce()
+{
+  uint32_t now = micros();
+  Task *chosen = 0;
+
+  for (uint8_t i = 0; i < taskCount; i++)
+  {
+    Task &t = tasks[i];
+    // Released if the release time isn't in the future (wrap-safe)
+    if ((int32_t)(now - t.releaseUs) < 0)
+    {
+      continue;
+    }
+    if (!chosen || t.priority > chosen->priority ||
+        (t.priority == chosen->priority &&
+         (int32_t)((t.releaseUs + t.deadlineUs) - (chosen->releaseUs + chosen->deadlineUs)) < 0))
+    {
+      chosen = &t;
+    }
+  }
+
+  if (!chosen)
+  {
+    return false;
+  }
+
+  uint32_t latency = now - chosen->releaseUs;
+  if (latency > chosen->deadlineUs)
+  {
+    chosen->misses++;
+  }
+  if (latency > chosen->maxLatencyUs)
+  {
+    chosen->maxLatencyUs = latency;
+  }
+
+  chosen->run();
+
+  uint32_t finished = micros();
+  if (finished - now > chosen->maxRunUs)
+  {
+    chosen->maxRunUs = finished - now;
+  }
+  chosen->runs++;
+
+  chosen->releaseUs += chosen->periodUs;
+  if ((int32_t)(now - chosen->releaseUs) >= 0)
+  {
+    chosen->releaseUs = now + chosen->periodUs;
+  }
+  return true;
+}
+
+void Scheduler::print(Print &out) const
+{
+  for (uint8_t i = 0; i < taskCount; i++)
+  {
+    const Task &t = tasks[i];
+    out.print(t.name);
+    out.print(F(": runs "));
+    out.print(t.runs);
+    out.print(F(", misses "));
+    out.print(t.misses);
+    out.print(F(", max latency us "));
+    out.print(t.maxLatencyUs);
+    out.print(F(", max run us "));
+    out.println(t.maxRunUs);
+  }
+}
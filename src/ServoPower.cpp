@@ -0,0 +1,152 @@
+#include "ServoPower.h"
+
+ServoPower::ServoPower(ArmServo *const servos[SERVO_COUNT], const uint8_t pins[SERVO_COUNT],
+                       Motion &motionEngine, Telemetry &telemetry)
+    : motion(motionEngine), out(telemetry), holdMask(0), wakeMask(0), wakeAtMs(0), statsStartMs(0)
+{
+  for (uint8_t i = 0; i < SERVO_COUNT; i++)
+  {
+    joints[i].servo = servos[i];
+    joints[i].pin = pins[i];
+    joints[i].attached = false;
+    joints[i].asleep = false;
+    joints[i].lastActiveMs = 0;
+    joints[i].attachedSinceMs = 0;
+    joints[i].attachedMs = 0;
+    joints[i].sleeps = 0;
+    joints[i].lateWakes = 0;
+  }
+}
+
+void ServoPower::attach(uint8_t joint)
+{
+  joints[joint].asleep = false;
+  if (!joints[joint].attached)
+  {
+    powerOn(joint);
+  }
+  joints[joint].lastActiveMs = millis();
+}
+
+void ServoPower::detach(uint8_t joint)
+{
+  joints[joint].asleep = false;
+  if (joints[joint].attached)
+  {
+    powerOff(joint);
+  }
+}
+
+void ServoPower::wake(uint8_t joint)
+{
+  if (joints[joint].asleep)
+  {
+    joints[joint].lateWakes++;
+    joints[joint].asleep = false;
+    powerOn(joint);
+  }
+  joints[joint].lastActiveMs = millis();
+}
+
+void ServoPower::wakeAt(uint8_t mask, unsigned long inMs)
+{
+  wakeMask = mask;
+  wakeAtMs = millis() + inMs;
+}
+
+void ServoPower::update(unsigned long idleMs)
+{
+  unsigned long now = millis();
+  bool wakeDue = wakeMask != 0 && (long)(now - wakeAtMs) >= 0;
+
+  for (uint8_t i = 0; i < SERVO_COUNT; i++)
+  {
+    Joint &j = joints[i];
+    if (motion.moving(i))
+    {
+      j.lastActiveMs = now;
+      continue;
+    }
+
+    if (wakeDue && (wakeMask & jointBit(i)))
+    {
+      if (j.asleep)
+      {
+        j.asleep = false;
+        powerOn(i);
+      }
+      j.lastActiveMs = now;
+      continue;
+    }
+
+    if (idleMs != 0 && j.attached && !(holdMask & jointBit(i)) &&
+        now - j.lastActiveMs >= idleMs)
+    {
+      powerOff(i);
+      j.asleep = true;
+      j.sleeps++;
+    }
+  }
+
+  if (wakeDue)
+  {
+    wakeMask = 0;
+  }
+}
+
+void ServoPower::powerOn(uint8_t joint)
+{
+  Joint &j = joints[joint];
+  j.servo->write(motion.angle(joint));
+  j.servo->attach(j.pin);
+  j.attached = true;
+  j.attachedSinceMs = millis();
+  out.send(EV_ATTACH, joint);
+}
+
+void ServoPower::powerOff(uint8_t joint)
+{
+  Joint &j = joints[joint];
+  j.servo->detach();
+  j.attached = false;
+  j.attachedMs += millis() - j.attachedSinceMs;
+  out.send(EV_DETACH, joint);
+}
+
+void ServoPower::print(Print &out) const
+{
+  unsigned long now = millis();
+  unsigned long elapsed = now - statsStartMs;
+  for (uint8_t i = 0; i < SERVO_COUNT; i++)
+  {
+    const Joint &j = joints[i];
+    unsigned long on = j.attachedMs;
+    if (j.attached)
+    {
+      on += now - j.attachedSinceMs;
+    }
+    out.print(F("servo "));
+    out.print(i);
+    out.print(j.attached ? F(": on ") : j.asleep ? F(": asleep ") : F(": off "));
+    out.print(elapsed >= 100 ? on / (elapsed / 100) : 0);
+    out.print(F("% of "));
+    out.print(elapsed / 1000);
+    out.print(F(" s, sleeps "));
+    out.print(j.sleeps);
+    out.print(F(", late wakes "));
+    out.println(j.lateWakes);
+  }
+}
+
+void ServoPower::resetStats()
+{
+  unsigned long now = millis();
+  statsStartMs = now;
+  for (uint8_t i = 0; i < SERVO_COUNT; i++)
+  {
+    joints[i].attachedMs = 0;
+    joints[i].attachedSinceMs = now;
+    joints[i].sleeps = 0;
+    joints[i].lateWakes = 0;
+  }
+}
@@ -0,0 +1,1484 @@
+#include "SorterStation.h"
+#include "Log.h"
+
+// Switch the sensor between 2%, 20% and 100% scaling based on the last reading
+const bool sensorAutoRange = true;
+
+// Where the color sensor sits. At the gripper (false) each object is read
+// once the arm is at the pick position. Upstream on the feed (true) every
+// object is read as it goes past and queued with the time it will reach
+// the pick position, feedTravelMs later, so the arm already knows the bin
+// when it gets there and sensing overlaps the rest of the cycle.
+const bool upstreamSensing = false;
+
+// Watch the clear channel while the arm approaches the pick position (see
+// armSenseAbortPos). Needs the sensor at the gripper.
+const bool approachSensing = !upstreamSensing;
+
+const uint8_t NO_JOINT = 0xFF;
+
+// The cycle's states. Each leaf runs its steps on SIG_ENTRY and
+// SIG_STEP_DONE and transitions when they are done:
+//
+//   active                  runs the move-then-dwell steps for every state
+//     homing                grabber self-test and initial position
+//     resume                warm boot: one move from the checkpointed pose
+//                           to the ready pose
+//     recover               warm boot holding an object: one move to the
+//                           end of transfer, then on to release
+//     idle                  wait between cycles
+//     approach              pick steps 1-4, watching for an object
+//     sense                 pick step 5, up to maxAttempts readings, or
+//                           wait for the object queued upstream
+//     grip                  pick steps 6-7, checking the object is held
+//                           and re-grabbing if it isn't
+//     transfer              pick steps 8-11, carry it to the bin
+//     release               release steps 1-5
+//     return                nothing left to sense on the way back
+//       returnEmpty         arm back to rest without an object
+//       returnFromBin       release steps 6-11
+//       returnToPick        next object already sensed: skip the rest
+//                           position and go straight into approach
+enum CycleSignal : uint8_t
+{
+  SIG_MOTION_DONE = SIG_USER, // The step's move has finished
+  SIG_STEP_DONE,              // The step's dwell has finished
+  SIG_PRESENCE,               // Clear channel saw an object
+  SIG_ARM_PAST_LIMIT,         // Approach got past armSenseAbortPos
+  SIG_SCAN_DONE,              // A color reading is ready
+  SIG_SELF_TEST,              // Operator asked for the self-test
+  SIG_OBJECT_QUEUED           // An object was classified upstream
+};
+
+SorterStation::SorterStation(uint8_t index, const StationPins &pins, ArmPoses &armPoses,
+                             SorterSettings &sorterSettings, Telemetry &telemetryOut, PerfCounters &perfCounters,
+                             TraceRecorder &recorder)
+    : id(index), poses(armPoses), settings(sorterSettings), telemetry(telemetryOut), perf(perfCounters),
+      traceRecorder(recorder),
+      servoList{&servos[SERVO_BASE], &servos[SERVO_ARM], &servos[SERVO_JOINT], &servos[SERVO_GRABBER1],
+                &servos[SERVO_GRABBER2]},
+      motion(servoList, telemetryOut),
+      power(servoList, pins.servos, motion, telemetryOut),
+      arm(power, motion, telemetryOut),
+      colorSensor(pins.s0, pins.s1, pins.s2, pins.s3, pins.sensorOut), checkpointPhase(STATE_HOMING),
+      redFreq(0), greenFreq(0), blueFreq(0),
+      detectedColor(COLOR_UNKNOWN), targetBasePosition(armPoses.baseBluePos), objectDetected(false),
+      sensorTimeouts(0), sensorScaleUsed(20),
+      scanRequest(SCAN_IDLE), presenceSeen(false), scanDone(false), scanStatus(SENSOR_OK),
+      feedReadingDone(false), feedSensedMs(0), feedAssigned(false), dispatched(false),
+      scanChannel(0), scanStartMs(0), scanStartUs(0), scanClear(0), scanFlags(0),
+      waitingJoint(NO_JOINT), pendingDwellMs(0), dwellActive(false), dwellStartMs(0), dwellLengthMs(0),
+      stateStep(0),
+      attempts(0), sorted(COLOR_NONE), approachWatching(false), approachFromBin(false),
+      selfTestRequested(false), cycleStartMs(0), sortedCount(0), lastCycleLengthMs(0),
+      gripFeedbackPin(pins.gripFeedback), gripGrabs(0), gripPending(false), gripWaiting(false), gripChecks(0),
+      gripsHeld(0), gripsAbandoned(0)
+{
+  scanReading.red = scanReading.green = scanReading.blue = 0;
+  scanNext = scanReading;
+  PT_INIT(&scanPt);
+}
+
+void SorterStation::begin(int checkpointAddress, uint8_t checkpointSlots, bool dispatchedByHost)
+{
+  telemetry.setSource(id);
+  dispatched = dispatchedByHost;
+
+  // A checkpoint taken during homing doesn't prove the servos are fine
+  bool warmBoot = checkpoint.begin(checkpointAddress, checkpointSlots) &&
+                  checkpoint.last().phase != STATE_HOMING;
+
+  // Set up the color sensor, starting at 20% frequency scaling
+  colorSensor.begin(sensorAutoRange, sensorSlowestReading);
+  if (gripFeedbackPin != GRIP_FEEDBACK_NONE)
+  {
+    pinMode(gripFeedbackPin, INPUT_PULLUP);
+  }
+  if (upstreamSensing && !dispatched)
+  {
+    scanRequest = SCAN_FEED;
+  }
+
+  // After a warm boot, attach at the checkpointed pose, which is where the
+  // servos were last sent, so nothing jumps further than the move that was
+  // under way when the board reset
+  LOG_INFO(F("Attaching servos..."));
+  for (uint8_t joint = 0; joint < SERVO_COUNT; joint++)
+  {
+    if (warmBoot)
+    {
+      motion.jumpTo(joint, checkpoint.last().angles[joint]);
+    }
+    arm.attach(joint);
+  }
+
+  // Start the cycle with the grabber test and homing, or go straight to
+  // the ready pose
+  power.resetStats();
+  cycle.setContext(this);
+  cycle.setObserver(observeState);
+  arm.hold(ALL_JOINTS);
+  if (!warmBoot)
+  {
+    cycle.start(homing);
+  }
+  else
+  {
+    cycle.start(recoveryState(checkpoint.last()));
+  }
+}
+
+bool SorterStation::updateMotion()
+{
+  telemetry.setSource(id);
+  return motion.update();
+}
+
+void SorterStation::updateScan()
+{
+  telemetry.setSource(id);
+  colorScan(&scanPt);
+}
+
+// Turn what the motion engine, the dwell timer and the scanning task have
+// done since last time into events for the cycle
+void SorterStation::updateCycle()
+{
+  telemetry.setSource(id);
+  if (waitingJoint != NO_JOINT && !motion.moving(waitingJoint))
+  {
+    waitingJoint = NO_JOINT;
+    cycle.dispatch(SIG_MOTION_DONE);
+  }
+  if (dwellActive && dwellDone())
+  {
+    dwellActive = false;
+    cycle.dispatch(SIG_STEP_DONE);
+  }
+  if (scanDone)
+  {
+    scanDone = false;
+    cycle.dispatch(SIG_SCAN_DONE);
+  }
+  if (presenceSeen)
+  {
+    presenceSeen = false;
+    cycle.dispatch(SIG_PRESENCE);
+  }
+  if (approachWatching && armPastAbortPos())
+  {
+    cycle.dispatch(SIG_ARM_PAST_LIMIT);
+  }
+  if (selfTestRequested)
+  {
+    selfTestRequested = false;
+    cycle.dispatch(SIG_SELF_TEST);
+  }
+  if (feedReadingDone)
+  {
+    feedReadingDone = false;
+    if (queueFeedObject())
+    {
+      cycle.dispatch(SIG_OBJECT_QUEUED);
+    }
+  }
+  if (feedAssigned)
+  {
+    feedAssigned = false;
+    cycle.dispatch(SIG_OBJECT_QUEUED);
+  }
+}
+
+void SorterStation::updatePower()
+{
+  telemetry.setSource(id);
+  power.update(settings.powerIdleMs);
+}
+
+void SorterStation::updateCheckpoint()
+{
+  // Every move started since the last run goes into one record
+  if (motion.takePoseChange())
+  {
+    saveCheckpoint();
+  }
+  checkpoint.update();
+}
+
+// One line per servo: commanded angle, speed, clamp count and power
+void SorterStation::printJoints(Print &out) const
+{
+  for (uint8_t joint = 0; joint < SERVO_COUNT; joint++)
+  {
+    JointState state = arm.state(joint);
+    out.print(F("servo "));
+    out.print(joint);
+    out.print(F(": angle "));
+    out.print(state.angle);
+    out.print(F(", deg/s "));
+    out.print(state.velocity);
+    out.print(F(", clamped "));
+    out.print(motion.clamped(joint));
+    out.println(state.attached ? F(", attached") : F(", detached"));
+  }
+}
+
+// Grabs checked and how many held, per arm
+void SorterStation::printGrip(Print &out) const
+{
+  out.print(F("grip: "));
+  out.print(gripChecks);
+  out.print(F(" checked, "));
+  out.print(gripsHeld);
+  out.print(F(" held ("));
+  out.print(gripChecks ? gripsHeld * 100 / gripChecks : 0);
+  out.print(F("%), "));
+  out.print(gripChecks - gripsHeld - gripsAbandoned);
+  out.print(F(" re-grabs, "));
+  out.print(gripsAbandoned);
+  out.println(gripCheckable() ? F(" abandoned") : F(" abandoned, not checked (no feedback input)"));
+}
+
+void SorterStation::resetGripStats()
+{
+  gripChecks = 0;
+  gripsHeld = 0;
+  gripsAbandoned = 0;
+}
+
+// Function to start waiting between steps, reported as a dwell
+void SorterStation::startDwell(unsigned int ms)
+{
+  uint8_t payload[2] = {(uint8_t)ms, (uint8_t)(ms >> 8)};
+  telemetry.send(EV_DWELL_START, payload, sizeof(payload));
+  dwellStartMs = millis();
+  dwellLengthMs = ms;
+}
+
+// Function to check whether the dwell is over
+bool SorterStation::dwellDone()
+{
+  if (millis() - dwellStartMs < dwellLengthMs)
+  {
+    return false;
+  }
+  telemetry.send(EV_DWELL_END);
+  return true;
+}
+
+// Function to start moving a servo gradually from where it was last sent
+void SorterStation::startMove(uint8_t joint, int endAngle, int delayMs)
+{
+  if (motion.idle())
+  {
+    perf.motionBegin();
+  }
+  arm.move(joint, endAngle, (uint8_t)delayMs);
+}
+
+// Function to start a dwell the cycle will be told about
+void SorterStation::runDwell(unsigned int ms)
+{
+  startDwell(ms);
+  dwellActive = true;
+}
+
+// Function to run one step: move a servo gradually, then dwell
+void SorterStation::runStep(uint8_t joint, int endAngle, int delayMs, unsigned int dwellMs)
+{
+  pendingDwellMs = dwellMs;
+  waitingJoint = joint;
+  startMove(joint, endAngle, delayMs);
+}
+
+// Function to finish a step on a move that is already under way, then dwell
+void SorterStation::awaitStep(uint8_t joint, unsigned int dwellMs)
+{
+  pendingDwellMs = dwellMs;
+  waitingJoint = joint;
+}
+
+// Function to forget about the current step (the state is leaving early)
+void SorterStation::cancelStep()
+{
+  waitingJoint = NO_JOINT;
+  dwellActive = false;
+}
+
+// Function to take one pulse from the selected sensor channel, counted as
+// blocking time
+SensorStatus SorterStation::sampleSensor(uint16_t &value)
+{
+  perf.blockingBegin();
+  SensorStatus status = colorSensor.sample(value);
+  perf.blockingEnd();
+  return status;
+}
+
+// Color scanning task. Waits for the filters to settle without blocking, so
+// only the pulse measurements themselves hold up the other tasks.
+PtState SorterStation::colorScan(Pt *pt)
+{
+  PT_BEGIN(pt);
+  for (;;)
+  {
+    PT_WAIT_WHILE(pt, scanRequest == SCAN_IDLE);
+
+    if (scanRequest == SCAN_PRESENCE)
+    {
+      // Watch the clear channel until the cycle calls it off
+      colorSensor.select(CHANNEL_CLEAR);
+      PT_WAIT_UNTIL(pt, colorSensor.settled() || scanRequest != SCAN_PRESENCE);
+      while (scanRequest == SCAN_PRESENCE)
+      {
+        if (sampleSensor(scanClear) == SENSOR_OK && scanClear <= (uint16_t)settings.approachPresenceMax)
+        {
+          presenceSeen = true;
+          scanRequest = SCAN_IDLE;
+        }
+        PT_YIELD(pt);
+      }
+      continue;
+    }
+
+    if (scanRequest == SCAN_GRIP)
+    {
+      // One look at whatever is between the jaws
+      colorSensor.select(CHANNEL_CLEAR);
+      PT_WAIT_UNTIL(pt, colorSensor.settled() || scanRequest != SCAN_GRIP);
+      if (scanRequest == SCAN_GRIP)
+      {
+        scanStatus = sampleSensor(scanClear);
+        scanRequest = SCAN_IDLE;
+        scanDone = true;
+      }
+      continue;
+    }
+
+    if (scanRequest == SCAN_FEED)
+    {
+      // Wait for the next object to come past the sensor
+      colorSensor.select(CHANNEL_CLEAR);
+      PT_WAIT_UNTIL(pt, colorSensor.settled());
+      while (sampleSensor(scanClear) != SENSOR_OK || scanClear > (uint16_t)settings.approachPresenceMax)
+      {
+        PT_YIELD(pt);
+      }
+    }
+
+    // Read red, green and blue at the current scaling, giving up at the deadline
+    scanStartMs = millis();
+    scanStartUs = micros();
+    sensorScaleUsed = colorSensor.scalePercent();
+    scanStatus = SENSOR_OK;
+    for (scanChannel = CHANNEL_RED; scanChannel <= CHANNEL_BLUE; scanChannel++)
+    {
+      if (scanChannel != CHANNEL_RED && millis() - scanStartMs > (unsigned long)settings.sensorDeadlineMs)
+      {
+        scanStatus = SENSOR_TIMEOUT;
+        break;
+      }
+      colorSensor.select((SensorChannel)scanChannel);
+      PT_WAIT_UNTIL(pt, colorSensor.settled());
+      uint16_t *value = scanChannel == CHANNEL_RED     ? &scanNext.red
+                        : scanChannel == CHANNEL_GREEN ? &scanNext.green
+                                                       : &scanNext.blue;
+      if (sampleSensor(*value) != SENSOR_OK)
+      {
+        scanStatus = SENSOR_TIMEOUT;
+        break;
+      }
+    }
+    if (scanStatus == SENSOR_OK)
+    {
+      scanReading = scanNext;
+    }
+    colorSensor.finishReading(scanStatus, scanNext);
+
+    // When recording, also take the clear channel and log the raw reading
+    if (traceRecorder.enabled())
+    {
+      scanClear = 0;
+      scanFlags = 0;
+      if (scanStatus != SENSOR_OK)
+      {
+        scanFlags |= TRACE_FLAG_TIMEOUT;
+      }
+      else
+      {
+        colorSensor.select(CHANNEL_CLEAR);
+        PT_WAIT_UNTIL(pt, colorSensor.settled());
+        if (sampleSensor(scanClear) != SENSOR_OK)
+        {
+          scanFlags |= TRACE_FLAG_NO_CLEAR;
+        }
+      }
+      traceRecorder.record(scanStartUs, (uint16_t)(millis() - scanStartMs), scanReading,
+                           scanClear, sensorScaleUsed, scanFlags);
+    }
+
+    if (scanRequest == SCAN_FEED)
+    {
+      // Hand the reading over, then wait for the object to move on so it
+      // isn't read twice
+      feedSensedMs = scanStartMs;
+      feedReadingDone = true;
+      colorSensor.select(CHANNEL_CLEAR);
+      PT_WAIT_UNTIL(pt, colorSensor.settled());
+      while (sampleSensor(scanClear) == SENSOR_OK && scanClear <= (uint16_t)settings.approachPresenceMax)
+      {
+        PT_YIELD(pt);
+      }
+      continue;
+    }
+
+    scanRequest = SCAN_IDLE;
+    scanDone = true;
+  }
+  PT_END(pt);
+}
+
+// Function to get the base position of a color's bin
+int SorterStation::binPosition(Color color) const
+{
+  return color == COLOR_RED ? poses.baseRedPos : color == COLOR_GREEN ? poses.baseGreenPos : poses.baseBluePos;
+}
+
+// Function to classify the reading the scanning task just took
+DetectResult SorterStation::classifyScan()
+{
+  if (scanStatus != SENSOR_OK)
+  {
+    LOG_WARN(F("Sensor timeout (scaling now "), colorSensor.scalePercent(), F("%)"));
+    detectedColor = COLOR_UNKNOWN;
+    return DETECT_TIMEOUT;
+  }
+  redFreq = scanReading.red;
+  greenFreq = scanReading.green;
+  blueFreq = scanReading.blue;
+
+  LOG_DEBUG(F("Red: "), redFreq);
+  LOG_DEBUG(F("Green: "), greenFreq);
+  LOG_DEBUG(F("Blue: "), blueFreq);
+  LOG_DEBUG(F("Sensor scaling: "), sensorScaleUsed, F("%"));
+
+  Classification result = arm.classify(scanReading);
+
+  LOG_DEBUG(F("Valid readings - Red: "), result.validRed ? F("Yes") : F("No"),
+            F(", Green: "), result.validGreen ? F("Yes") : F("No"),
+            F(", Blue: "), result.validBlue ? F("Yes") : F("No"));
+
+  // Set the detected color and target position
+  switch (result.color)
+  {
+  case COLOR_RED:
+    LOG_INFO(F("Detected RED object (within range and dominant)"));
+    targetBasePosition = poses.baseRedPos;
+    break;
+  case COLOR_GREEN:
+    LOG_INFO(F("Detected GREEN object (within range and dominant)"));
+    targetBasePosition = poses.baseGreenPos;
+    break;
+  case COLOR_BLUE:
+    LOG_INFO(F("Detected BLUE object (within range and dominant)"));
+    targetBasePosition = poses.baseBluePos;
+    break;
+  case COLOR_NONE:
+    LOG_INFO(F("UNKNOWN (all readings out of valid range)"));
+    detectedColor = COLOR_UNKNOWN;
+    return DETECT_NONE; // No valid object detected
+  default:
+    LOG_INFO(F("Ambiguous - lowest valid color is "), colorName(result.lowest),
+             F(" but not clearly dominant"));
+    detectedColor = COLOR_UNKNOWN;
+    return DETECT_NONE; // No clear color detected, wait for better reading
+  }
+
+  detectedColor = result.color;
+  return DETECT_OBJECT; // Object detected
+}
+
+// Function to classify the scan and report the detection result
+DetectResult SorterStation::detectObject()
+{
+  DetectResult result = classifyScan();
+
+  uint8_t payload[9] = {(uint8_t)result, (uint8_t)detectedColor,
+                        (uint8_t)redFreq, (uint8_t)(redFreq >> 8),
+                        (uint8_t)greenFreq, (uint8_t)(greenFreq >> 8),
+                        (uint8_t)blueFreq, (uint8_t)(blueFreq >> 8),
+                        sensorScaleUsed};
+  telemetry.send(EV_SENSE_RESULT, payload, sizeof(payload));
+  return result;
+}
+
+// Function to check whether the arm has gone past the point where an object
+// should have been seen
+bool SorterStation::armPastAbortPos() const
+{
+  int angle = motion.angle(SERVO_ARM);
+  return (poses.armPickPos >= poses.armMidPos) ? angle > settings.armSenseAbortPos : angle < settings.armSenseAbortPos;
+}
+
+// Function to classify a reading taken upstream and queue the object.
+// Leaves the cycle's own detection alone: the arm may be carrying an
+// earlier object. Objects that can't be classified aren't queued, so the
+// arm doesn't wait for them.
+bool SorterStation::queueFeedObject()
+{
+  if (scanStatus != SENSOR_OK)
+  {
+    sensorTimeouts++;
+    LOG_WARN(F("Feed sensor timeout - object not queued"));
+    return false;
+  }
+  Color color = arm.classify(scanReading).color;
+  if (color != COLOR_RED && color != COLOR_GREEN && color != COLOR_BLUE)
+  {
+    LOG_INFO(F("Unclassified object on the feed - not queued"));
+    return false;
+  }
+  if (!feedQueue.push(color, feedSensedMs, settings.feedTravelMs))
+  {
+    LOG_WARN(F("Feed queue full - "), colorName(color), F(" object dropped"));
+    return false;
+  }
+
+  long arrivesMs = (long)(feedSensedMs + settings.feedTravelMs - millis());
+  uint16_t inMs = arrivesMs <= 0 ? 0 : arrivesMs > 0xFFFF ? 0xFFFF : (uint16_t)arrivesMs;
+  uint8_t payload[4] = {(uint8_t)color, feedQueue.count(), (uint8_t)inMs, (uint8_t)(inMs >> 8)};
+  telemetry.send(EV_FEED_OBJECT, payload, sizeof(payload));
+  LOG_INFO(F("Queued "), colorName(color), F(" object, "), feedQueue.count(), F(" on the feed"));
+  return true;
+}
+
+bool SorterStation::assignObject(Color color, unsigned long travelMs)
+{
+  telemetry.setSource(id);
+  if (!feedQueue.push(color, millis(), travelMs))
+  {
+    LOG_WARN(F("Feed queue full - assigned "), colorName(color), F(" object refused"));
+    return false;
+  }
+
+  uint16_t inMs = travelMs > 0xFFFF ? 0xFFFF : (uint16_t)travelMs;
+  uint8_t payload[4] = {(uint8_t)color, feedQueue.count(), (uint8_t)inMs, (uint8_t)(inMs >> 8)};
+  telemetry.send(EV_FEED_OBJECT, payload, sizeof(payload));
+  LOG_INFO(F("Assigned "), colorName(color), F(" object, "), feedQueue.count(), F(" on the feed"));
+  feedAssigned = true;
+  return true;
+}
+
+// Function to take the oldest queued object as the one now at the pick
+// position
+void SorterStation::takeQueuedObject()
+{
+  detectedColor = feedQueue.front().color;
+  targetBasePosition = binPosition(detectedColor);
+  objectDetected = true;
+  feedQueue.pop();
+  LOG_INFO(F("Queued "), colorName(detectedColor), F(" object has arrived"));
+}
+
+// Hook for knowing the next object is already waiting when one has just
+// been released, so the arm can go straight back to the pick position.
+// Only the upstream sensor can tell.
+bool SorterStation::nextObjectSensed() const
+{
+  return queuedFeed() && !feedQueue.empty();
+}
+
+// Function to check whether objects come off the feed queue, classified
+// before they get here, rather than being read at the pick position
+bool SorterStation::queuedFeed() const
+{
+  return upstreamSensing || dispatched;
+}
+
+// Function to end a cycle: report what was sorted and the counters
+void SorterStation::endCycle()
+{
+  telemetry.send(EV_CYCLE_END, (uint8_t)sorted);
+  if (sorted != COLOR_NONE)
+  {
+    sortedCount++;
+    lastCycleLengthMs = millis() - cycleStartMs;
+  }
+
+  // Report the counters. The ISR load is sampled by main.cpp's isrLoadTask
+  // when every arm is quiet, not here.
+  uint8_t stats[PERF_STATS_SIZE];
+  telemetry.send(EV_STATS, stats, perf.pack(stats));
+}
+
+// Function to start one color reading for the Sense state
+void SorterStation::startScan()
+{
+  telemetry.send(EV_ATTEMPT, (uint8_t)(attempts + 1), (uint8_t)settings.maxAttempts);
+  telemetry.send(EV_SENSE_START);
+  scanDone = false;
+  scanRequest = SCAN_COLOR;
+}
+
+// Function to check whether a grip can be verified: with the feedback
+// input, or with the color sensor if it is at the gripper
+bool SorterStation::gripCheckable() const
+{
+  return gripFeedbackPin != GRIP_FEEDBACK_NONE || !queuedFeed();
+}
+
+// Function to start checking the grip, overlapping the dwell after it
+void SorterStation::startGripCheck()
+{
+  gripWaiting = false;
+  gripPending = gripFeedbackPin == GRIP_FEEDBACK_NONE && gripCheckable();
+  if (gripPending)
+  {
+    scanDone = false;
+    scanRequest = SCAN_GRIP;
+  }
+}
+
+// Function to act on the grip check: carry on with the object, re-grab it,
+// or give up on this pick
+void SorterStation::finishGripCheck(StateMachine &machine)
+{
+  if (!gripCheckable())
+  {
+    machine.transition(transfer);
+    return;
+  }
+
+  bool held;
+  uint16_t clear = 0xFFFF;
+  if (gripFeedbackPin != GRIP_FEEDBACK_NONE)
+  {
+    held = digitalRead(gripFeedbackPin) == LOW;
+  }
+  else
+  {
+    held = scanStatus == SENSOR_OK && scanClear <= (uint16_t)settings.approachPresenceMax;
+    if (scanStatus == SENSOR_OK)
+    {
+      clear = scanClear;
+    }
+  }
+  gripGrabs++;
+  gripChecks++;
+  uint8_t payload[4] = {(uint8_t)held, gripGrabs, (uint8_t)clear, (uint8_t)(clear >> 8)};
+  telemetry.send(EV_GRIP_CHECK, payload, sizeof(payload));
+
+  if (held)
+  {
+    gripsHeld++;
+    LOG_INFO(F("Object held"));
+    machine.transition(transfer);
+    return;
+  }
+  if (gripGrabs <= settings.gripRetries)
+  {
+    // Short re-grab: open and close again where the arm is, instead of
+    // carrying an empty grabber to the bin
+    LOG_WARN(F("Grabber is empty - re-grabbing (grab "), gripGrabs + 1, F(" of "), settings.gripRetries + 1, F(")"));
+    arm.releasing();
+    stateStep = 2;
+    runStep(SERVO_GRABBER2, poses.grabberOpenPos, settings.moveDelayMs, 0);
+    return;
+  }
+  gripsAbandoned++;
+  LOG_WARN(F("Grabber empty after "), gripGrabs, F(" grabs - giving up"));
+  objectDetected = false;
+  detectedColor = COLOR_UNKNOWN;
+  machine.transition(returnEmpty);
+}
+
+const State SorterStation::active = {stateHandler<&SorterStation::activeState>, 0, STATE_ACTIVE};
+const State SorterStation::homing = {stateHandler<&SorterStation::homingState>, &active, STATE_HOMING};
+const State SorterStation::resume = {stateHandler<&SorterStation::resumeState>, &active, STATE_RESUME};
+const State SorterStation::recover = {stateHandler<&SorterStation::recoverState>, &active, STATE_RECOVER};
+const State SorterStation::idle = {stateHandler<&SorterStation::idleState>, &active, STATE_IDLE};
+const State SorterStation::approach = {stateHandler<&SorterStation::approachState>, &active, STATE_APPROACH};
+const State SorterStation::sense = {stateHandler<&SorterStation::senseState>, &active, STATE_SENSE};
+const State SorterStation::grip = {stateHandler<&SorterStation::gripState>, &active, STATE_GRIP};
+const State SorterStation::transfer = {stateHandler<&SorterStation::transferState>, &active, STATE_TRANSFER};
+const State SorterStation::release = {stateHandler<&SorterStation::releaseState>, &active, STATE_RELEASE};
+const State SorterStation::returning = {stateHandler<&SorterStation::returnState>, &active, STATE_RETURN};
+const State SorterStation::returnEmpty = {stateHandler<&SorterStation::returnEmptyState>, &returning, STATE_RETURN_EMPTY};
+const State SorterStation::returnFromBin = {stateHandler<&SorterStation::returnFromBinState>, &returning, STATE_RETURN_FROM_BIN};
+const State SorterStation::returnToPick = {stateHandler<&SorterStation::returnToPickState>, &returning, STATE_RETURN_TO_PICK};
+
+bool SorterStation::activeState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    cancelStep();
+    return true;
+  case SIG_MOTION_DONE:
+    // Moves are always followed by the step's dwell
+    runDwell(pendingDwellMs);
+    return true;
+  case SIG_SELF_TEST:
+    machine.transition(homing);
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool SorterStation::homingState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    // A self-test can come in the middle of another state's step: drop its
+    // move, dwell and sensor reading so none of them ends up in here. The
+    // upstream sensor keeps reading the feed.
+    cancelStep();
+    for (uint8_t joint = 0; joint < SERVO_COUNT; joint++)
+    {
+      motion.stop(joint);
+    }
+    if (scanRequest != SCAN_FEED)
+    {
+      scanRequest = SCAN_IDLE;
+    }
+
+    // Test grabberServo2 first to verify it's working. Everything stays
+    // powered until the cycle heads back empty-handed. A self-test after
+    // release has parked and detached the grabber would otherwise sweep a
+    // limp servo: writes don't reattach a joint detached on purpose.
+    LOG_INFO(F("Testing grabber servo 2..."));
+    for (uint8_t joint = 0; joint < SERVO_COUNT; joint++)
+    {
+      arm.attach(joint);
+    }
+    arm.hold(ALL_JOINTS);
+    stateStep = 0;
+    arm.write(SERVO_GRABBER2, JOINT_LIMITS[SERVO_GRABBER2].minAngle);
+    runStep(SERVO_GRABBER2, JOINT_LIMITS[SERVO_GRABBER2].maxAngle, settings.moveDelayMs, settings.stepDwellMs);
+    return true;
+  case SIG_STEP_DONE:
+    switch (++stateStep)
+    {
+    case 1:
+      runStep(SERVO_GRABBER2, JOINT_LIMITS[SERVO_GRABBER2].minAngle, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 2:
+      // Set initial positions. Make sure grabberServo2 is attached and set
+      // the base to object position (forward)
+      arm.attach(SERVO_GRABBER2);
+      arm.write(SERVO_BASE, poses.baseObjectPos);
+      runDwell(settings.stepDwellMs);
+      break;
+    case 3:
+      // Set arm to rest position
+      arm.write(SERVO_ARM, poses.armRestPos);
+      runDwell(settings.stepDwellMs);
+      break;
+    case 4:
+      // Set joint to pick position (90 degrees)
+      arm.write(SERVO_JOINT, poses.jointPickPos);
+      runDwell(settings.stepDwellMs);
+      break;
+    case 5:
+      // Set grabberServo1 to initial position
+      arm.write(SERVO_GRABBER1, poses.grabber1RestPos);
+      runDwell(settings.stepDwellMs);
+      break;
+    case 6:
+      // Close grabber
+      runStep(SERVO_GRABBER2, poses.grabberClosedPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 7:
+      LOG_INFO(F("Initial position set"));
+      LOG_INFO(F("Robotic Arm Ready!"));
+      runDwell(settings.settleDwellMs);
+      break;
+    default:
+      approachFromBin = false;
+      machine.transition(approach);
+      break;
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Function to move every joint to a pose at once, timed so they all arrive
+// together, and dwell once the last one is there
+void SorterStation::moveToPose(const int pose[SERVO_COUNT])
+{
+  int travel[SERVO_COUNT];
+  unsigned long totalMs = 0;
+  uint8_t slowest = NO_JOINT;
+
+  for (uint8_t joint = 0; joint < SERVO_COUNT; joint++)
+  {
+    travel[joint] = abs(pose[joint] - motion.angle(joint));
+    unsigned long ms = (unsigned long)travel[joint] * (joint == SERVO_BASE ? settings.baseMoveDelayMs : settings.moveDelayMs);
+    if (travel[joint] > 0 && ms >= totalMs)
+    {
+      totalMs = ms;
+      slowest = joint;
+    }
+  }
+
+  if (slowest == NO_JOINT)
+  {
+    runDwell(settings.stepDwellMs);
+    return;
+  }
+  for (uint8_t joint = 0; joint < SERVO_COUNT; joint++)
+  {
+    if (joint == slowest || travel[joint] == 0)
+    {
+      continue;
+    }
+    unsigned long ms = totalMs / travel[joint];
+    startMove(joint, pose[joint], (int)min(ms, 255UL));
+  }
+  runStep(slowest, pose[slowest], (int)min(totalMs / travel[slowest], 255UL), settings.stepDwellMs);
+}
+
+bool SorterStation::resumeState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    LOG_INFO(F("Warm boot - resuming from checkpoint"));
+    arm.hold(ALL_JOINTS);
+    {
+      const int ready[SERVO_COUNT] = {poses.baseObjectPos, poses.armRestPos, poses.jointPickPos, poses.grabber1RestPos, poses.grabberClosedPos};
+      moveToPose(ready);
+    }
+    return true;
+  case SIG_STEP_DONE:
+    LOG_INFO(F("Robotic Arm Ready!"));
+    approachFromBin = false;
+    machine.transition(approach);
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool SorterStation::recoverState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    // Back to where transfer leaves the object (pick step 11), grabber
+    // untouched, then release it as usual
+    LOG_WARN(F("Holding "), colorName(detectedColor), F(" object after reset - finishing"));
+    arm.hold(ALL_JOINTS);
+    arm.gripped();
+    {
+      const int carry[SERVO_COUNT] = {targetBasePosition, poses.armRestPos, poses.jointLiftPos, poses.grabber1PickPos,
+                                      motion.angle(SERVO_GRABBER2)};
+      moveToPose(carry);
+    }
+    return true;
+  case SIG_STEP_DONE:
+    machine.transition(release);
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool SorterStation::idleState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    if (sorted != COLOR_NONE)
+    {
+      LOG_INFO(F("Cycle complete - waiting before next cycle"));
+      runDwell(settings.cycleDwellMs);
+    }
+    else
+    {
+      // If no object was detected, wait a bit before trying again
+      LOG_INFO(F("No object detected - waiting before trying again"));
+      runDwell(settings.idleDwellMs);
+    }
+    // Servos that went to sleep are back and holding when the next cycle
+    // starts moving
+    arm.wakeBefore(ALL_JOINTS, dwellLengthMs, settings.powerLeadMs);
+    stateStep = 0;
+    return true;
+  case SIG_STEP_DONE:
+    endCycle();
+    if (queuedFeed() && feedQueue.empty())
+    {
+      // Nothing on its way yet; go as soon as something is queued
+      LOG_INFO(F("Waiting for an object on the feed"));
+      stateStep = 1;
+      return true;
+    }
+    approachFromBin = false;
+    machine.transition(approach);
+    return true;
+  case SIG_OBJECT_QUEUED:
+    if (stateStep == 1)
+    {
+      approachFromBin = false;
+      machine.transition(approach);
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Function to run pick step 4: move arm to picking position (140), watching
+// for an object on the way. The filter settles while the arm is already moving.
+void SorterStation::startApproachMove()
+{
+  arm.step(SEQ_PICK, 4);
+  LOG_INFO(F("Moving arm to picking position"));
+  if (approachSensing && !dispatched)
+  {
+    presenceSeen = false;
+    scanRequest = SCAN_PRESENCE;
+    approachWatching = true;
+  }
+  runStep(SERVO_ARM, poses.armPickPos, settings.moveDelayMs, settings.stepDwellMs);
+}
+
+bool SorterStation::approachState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    telemetry.send(EV_CYCLE_START);
+    cycleStartMs = millis();
+    LOG_INFO(F("Waiting for object..."));
+    LOG_INFO(F("PICKING UP OBJECT"));
+    arm.hold(ALL_JOINTS);
+    sorted = COLOR_NONE;
+    objectDetected = false;
+    if (approachFromBin)
+    {
+      // Coming straight from the bin: attached, open and in position
+      stateStep = 4;
+      startApproachMove();
+      return true;
+    }
+
+    // Make sure grabberServo2 is attached
+    arm.attach(SERVO_GRABBER2);
+    LOG_INFO(F("Grabber servo attached"));
+    stateStep = 0;
+    runDwell(settings.attachDwellMs);
+    return true;
+
+  case SIG_STEP_DONE:
+    switch (++stateStep)
+    {
+    case 1:
+      // 1. Move arm to middle position (60)
+      arm.step(SEQ_PICK, 1);
+      LOG_INFO(F("Moving arm to middle position"));
+      runStep(SERVO_ARM, poses.armMidPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 2:
+      // 2. Move grabberServo1 to optimal position
+      arm.step(SEQ_PICK, 2);
+      LOG_INFO(F("Adjusting grabber position"));
+      runStep(SERVO_GRABBER1, poses.grabber1PickPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 3:
+      // 3. Open grabber
+      arm.step(SEQ_PICK, 3);
+      LOG_INFO(F("Opening grabber"));
+      runStep(SERVO_GRABBER2, poses.grabberOpenPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 4:
+      startApproachMove();
+      break;
+    default:
+      machine.transition(sense);
+      break;
+    }
+    return true;
+
+  case SIG_PRESENCE:
+    // Keep going to the pick position
+    approachWatching = false;
+    return true;
+
+  case SIG_MOTION_DONE:
+  case SIG_ARM_PAST_LIMIT:
+    if (!approachWatching)
+    {
+      return false; // The move finished normally; dwell as usual
+    }
+    cancelStep();
+    motion.stop(SERVO_ARM);
+    LOG_INFO(F("No object seen by arm position "), motion.angle(SERVO_ARM), F(". Aborting approach."));
+    telemetry.send(EV_APPROACH_ABORT, (uint8_t)motion.angle(SERVO_ARM));
+    machine.transition(returnEmpty);
+    return true;
+
+  case SIG_EXIT:
+    approachWatching = false;
+    if (scanRequest == SCAN_PRESENCE)
+    {
+      scanRequest = SCAN_IDLE;
+    }
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+bool SorterStation::senseState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    // 5. Wait for a valid object with identifiable color, trying up to
+    // maxAttempts times with a pause between attempts
+    arm.step(SEQ_PICK, 5);
+    if (queuedFeed())
+    {
+      // Already classified upstream: wait for it to get here, if it hasn't
+      if (feedQueue.empty())
+      {
+        LOG_INFO(F("Nothing queued on the feed. Returning to start position."));
+        machine.transition(returnEmpty);
+        return true;
+      }
+      LOG_INFO(F("Waiting for the queued "), colorName(feedQueue.front().color), F(" object"));
+      runDwell(feedQueue.msUntilArrival());
+      return true;
+    }
+    LOG_INFO(F("Checking for object with identifiable color..."));
+    attempts = 0;
+    traceRecorder.markCycleStart();
+    startScan();
+    return true;
+
+  case SIG_SCAN_DONE:
+  {
+    DetectResult result = detectObject();
+    objectDetected = (result == DETECT_OBJECT);
+    if (objectDetected)
+    {
+      LOG_INFO(F("Valid object detected!"));
+      machine.transition(grip);
+      return true;
+    }
+
+    attempts++;
+    if (result == DETECT_TIMEOUT)
+    {
+      sensorTimeouts++;
+    }
+    if (attempts < settings.maxAttempts)
+    {
+      if (result == DETECT_TIMEOUT)
+      {
+        LOG_WARN(F("Sensor timed out. Waiting... (Attempt "), attempts, F(" of "), settings.maxAttempts, F(")"));
+      }
+      else
+      {
+        LOG_INFO(F("No valid object detected. Waiting... (Attempt "), attempts, F(" of "), settings.maxAttempts, F(")"));
+      }
+      runDwell(settings.retryDwellMs); // Wait before trying again
+      return true;
+    }
+
+    LOG_INFO(F("No valid object detected after multiple attempts. Returning to start position."));
+    machine.transition(returnEmpty);
+    return true;
+  }
+
+  case SIG_STEP_DONE:
+    if (queuedFeed())
+    {
+      takeQueuedObject();
+      machine.transition(grip);
+      return true;
+    }
+    startScan();
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+bool SorterStation::gripState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    // 6. Close grabber to grab object
+    arm.step(SEQ_PICK, 6);
+    LOG_INFO(F("Closing grabber to grab object"));
+    gripGrabs = 0;
+    stateStep = 0;
+    runStep(SERVO_GRABBER2, poses.grabberClosedPos, settings.moveDelayMs, settings.stepDwellMs);
+    return true;
+  case SIG_STEP_DONE:
+    switch (++stateStep)
+    {
+    case 1:
+      // 7. Let the grip-hold policy deal with the grabber while holding,
+      // and check the object is there while the dwell runs
+      arm.step(SEQ_PICK, 7);
+      arm.gripped();
+      startGripCheck();
+      runDwell(settings.stepDwellMs);
+      break;
+    case 2:
+      if (gripPending)
+      {
+        gripWaiting = true;
+        break;
+      }
+      finishGripCheck(machine);
+      break;
+    default:
+      // Re-grab: the grabber is open again, close it
+      arm.step(SEQ_PICK, 6);
+      LOG_INFO(F("Closing grabber to grab object"));
+      stateStep = 0;
+      runStep(SERVO_GRABBER2, poses.grabberClosedPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    }
+    return true;
+  case SIG_SCAN_DONE:
+    gripPending = false;
+    if (gripWaiting)
+    {
+      gripWaiting = false;
+      finishGripCheck(machine);
+    }
+    return true;
+  case SIG_EXIT:
+    gripPending = false;
+    gripWaiting = false;
+    if (scanRequest == SCAN_GRIP)
+    {
+      scanRequest = SCAN_IDLE;
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool SorterStation::transferState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    // 8. Move arm back to middle position
+    arm.step(SEQ_PICK, 8);
+    LOG_INFO(F("Moving arm to middle position"));
+    stateStep = 0;
+    runStep(SERVO_ARM, poses.armMidPos, settings.moveDelayMs, settings.stepDwellMs);
+    return true;
+  case SIG_STEP_DONE:
+    switch (++stateStep)
+    {
+    case 1:
+      // 9. Move arm to rest position (0)
+      arm.step(SEQ_PICK, 9);
+      LOG_INFO(F("Moving arm to rest position"));
+      runStep(SERVO_ARM, poses.armRestPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 2:
+      // 10. Move joint to lifting position (0) using gradual movement
+      arm.step(SEQ_PICK, 10);
+      LOG_INFO(F("Moving joint to lifting position"));
+      if (queuedFeed())
+      {
+        // The bin was known before the pick; turn toward it while lifting
+        LOG_INFO(F("Turning base toward "), colorName(detectedColor), F(" bin"));
+        startMove(SERVO_BASE, targetBasePosition, settings.baseMoveDelayMs);
+      }
+      runStep(SERVO_JOINT, poses.jointLiftPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 3:
+      // 11. Move base to position based on detected color
+      arm.step(SEQ_PICK, 11);
+      if (queuedFeed())
+      {
+        awaitStep(SERVO_BASE, settings.settleDwellMs);
+        break;
+      }
+      LOG_INFO(F("Moving base to "), colorName(detectedColor), F(" position ("),
+               targetBasePosition, F(" degrees)"));
+      runStep(SERVO_BASE, targetBasePosition, settings.baseMoveDelayMs, settings.settleDwellMs);
+      break;
+    case 4:
+      runDwell(settings.stepDwellMs);
+      break;
+    default:
+      machine.transition(release);
+      break;
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool SorterStation::releaseState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    LOG_INFO(F("RELEASING OBJECT"));
+    sorted = detectedColor;
+
+    // 1. Move arm to middle position (60)
+    arm.step(SEQ_RELEASE, 1);
+    LOG_INFO(F("Moving arm to middle position"));
+    stateStep = 0;
+    runStep(SERVO_ARM, poses.armMidPos, settings.moveDelayMs, settings.stepDwellMs);
+    return true;
+  case SIG_STEP_DONE:
+    switch (++stateStep)
+    {
+    case 1:
+      // 2. Return joint to pick position (90)
+      arm.step(SEQ_RELEASE, 2);
+      LOG_INFO(F("Moving joint to picking position"));
+      runStep(SERVO_JOINT, poses.jointPickPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 2:
+      // 3. Move arm to release position (120, safer than 140)
+      arm.step(SEQ_RELEASE, 3);
+      LOG_INFO(F("Moving arm to release position"));
+      runStep(SERVO_ARM, poses.armReleasePos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 3:
+      // 4. Get the grabber ready to open
+      arm.step(SEQ_RELEASE, 4);
+      arm.releasing();
+      runDwell(settings.stepDwellMs);
+      break;
+    case 4:
+      // 5. Open grabber to release object
+      arm.step(SEQ_RELEASE, 5);
+      LOG_INFO(F("Opening grabber to release object"));
+      runStep(SERVO_GRABBER2, poses.grabberOpenPos, settings.moveDelayMs, settings.settleDwellMs);
+      break;
+    default:
+      machine.transition(nextObjectSensed() ? returnToPick : returnFromBin);
+      break;
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool SorterStation::returnState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    // Nothing to look at or carry on the way back, so idle servos can rest.
+    // The upstream sensor keeps reading the feed.
+    if (scanRequest != SCAN_FEED)
+    {
+      scanRequest = SCAN_IDLE;
+    }
+    arm.hold(0);
+    return true;
+  case SIG_EXIT:
+    objectDetected = false;
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool SorterStation::returnEmptyState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    // Return to mid position
+    stateStep = 0;
+    runStep(SERVO_ARM, poses.armMidPos, settings.moveDelayMs, settings.stepDwellMs);
+    return true;
+  case SIG_STEP_DONE:
+    switch (++stateStep)
+    {
+    case 1:
+      // Return to rest position
+      runStep(SERVO_ARM, poses.armRestPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 2:
+      // Reset grabberServo1
+      runStep(SERVO_GRABBER1, poses.grabber1RestPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 3:
+      runDwell(settings.stepDwellMs);
+      break;
+    default:
+      machine.transition(idle);
+      break;
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool SorterStation::returnFromBinState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    // 6. Move arm back to middle position
+    arm.step(SEQ_RELEASE, 6);
+    LOG_INFO(F("Moving arm to middle position"));
+    stateStep = 0;
+    runStep(SERVO_ARM, poses.armMidPos, settings.moveDelayMs, settings.stepDwellMs);
+    return true;
+  case SIG_STEP_DONE:
+    switch (++stateStep)
+    {
+    case 1:
+      // 7. Close grabber
+      arm.step(SEQ_RELEASE, 7);
+      LOG_INFO(F("Closing grabber"));
+      runStep(SERVO_GRABBER2, poses.grabberClosedPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 2:
+      // 8. Reset grabberServo1 to initial position
+      arm.step(SEQ_RELEASE, 8);
+      LOG_INFO(F("Resetting grabber position"));
+      runStep(SERVO_GRABBER1, poses.grabber1RestPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 3:
+      // 9. Move arm back to rest position
+      arm.step(SEQ_RELEASE, 9);
+      LOG_INFO(F("Moving arm to rest position"));
+      runStep(SERVO_ARM, poses.armRestPos, settings.moveDelayMs, settings.stepDwellMs);
+      break;
+    case 4:
+      // 10. Move base back to object position
+      arm.step(SEQ_RELEASE, 10);
+      LOG_INFO(F("Moving base to object position"));
+      runStep(SERVO_BASE, poses.baseObjectPos, settings.baseMoveDelayMs, settings.settleDwellMs);
+      break;
+    case 5:
+      // 11. Park the grabber until next cycle
+      arm.step(SEQ_RELEASE, 11);
+      arm.parked();
+      runDwell(settings.stepDwellMs);
+      break;
+    default:
+      machine.transition(idle);
+      break;
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool SorterStation::returnToPickState(StateMachine &machine, uint8_t signal)
+{
+  switch (signal)
+  {
+  case SIG_ENTRY:
+    // Arm to the middle and base back to the object position, leaving the
+    // grabber open and attached for the next pick
+    LOG_INFO(F("Next object already sensed - skipping return to rest"));
+    stateStep = 0;
+    runStep(SERVO_ARM, poses.armMidPos, settings.moveDelayMs, settings.stepDwellMs);
+    return true;
+  case SIG_STEP_DONE:
+    if (++stateStep == 1)
+    {
+      runStep(SERVO_BASE, poses.baseObjectPos, settings.baseMoveDelayMs, settings.settleDwellMs);
+    }
+    else
+    {
+      endCycle();
+      approachFromBin = true;
+      machine.transition(approach);
+    }
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Function to report each state as it is entered and checkpoint it
+void SorterStation::reportState(uint8_t state)
+{
+  telemetry.send(EV_STATE, state);
+  checkpointPhase = state;
+  saveCheckpoint();
+}
+
+// Function to checkpoint the commanded pose: where every joint was last
+// told to go. It is taken at every state entry and move start, so a reset
+// in the middle of a state leaves at most the move in progress unfinished,
+// not every move since the state began. save() only stages the record, so
+// moves started while one is still being written share the next slot.
+void SorterStation::saveCheckpoint()
+{
+  uint8_t angles[SERVO_COUNT];
+  for (uint8_t joint = 0; joint < SERVO_COUNT; joint++)
+  {
+    angles[joint] = (uint8_t)motion.commanded(joint);
+  }
+  checkpoint.save(checkpointPhase, objectDetected ? detectedColor : COLOR_NONE, angles);
+}
+
+void SorterStation::observeState(StateMachine &machine, uint8_t state)
+{
+  static_cast<SorterStation *>(machine.context())->reportState(state);
+}
+
+// Function to pick how a warm boot carries on from the checkpointed phase.
+// An object in the grabber is finished off if its color is known; anything
+// else, or a second reset while recovering, abandons the cycle and starts
+// over from the ready pose.
+const State &SorterStation::recoveryState(const CheckpointRecord &saved)
+{
+  Color color = (Color)saved.color;
+  bool knownColor = color == COLOR_RED || color == COLOR_GREEN || color == COLOR_BLUE;
+  if (!knownColor)
+  {
+    return resume;
+  }
+
+  switch (saved.phase)
+  {
+  case STATE_GRIP:
+  case STATE_TRANSFER:
+  case STATE_RELEASE:
+    break;
+  case STATE_RECOVER:
+    LOG_WARN(F("Reset again while recovering - abandoning the cycle"));
+    return resume;
+  default:
+    return resume;
+  }
+
+  detectedColor = color;
+  objectDetected = true;
+  targetBasePosition = binPosition(color);
+  if (saved.phase == STATE_GRIP)
+  {
+    // Still at the pick position: just close the grabber again
+    return grip;
+  }
+  return recover;
+}
@@ -0,0 +1,84 @@
+#include "StateMachine.h"
+
+StateMachine::StateMachine() : current(0), pending(0), onEnter(0), owner(0)
+{
+}
+
+void StateMachine::start(const State &initial)
+{
+  current = 0;
+  pending = &initial;
+  runTransitions();
+}
+
+void StateMachine::dispatch(uint8_t signal)
+{
+  for (const State *s = current; s; s = s->parent)
+  {
+    if (s->handler(*this, signal))
+    {
+      break;
+    }
+  }
+  runTransitions();
+}
+
+bool StateMachine::in(const State &s) const
+{
+  return contains(&s, current);
+}
+
+// True if inner is outer or nested somewhere inside it
+bool StateMachine::contains(const State *outer, const State *inner)
+{
+  for (const State *s = inner; s; s = s->parent)
+  {
+    if (s == outer)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void StateMachine::runTransitions()
+{
+  while (pending)
+  {
+    const State *target = pending;
+    pending = 0;
+
+    // Nearest state strictly above the target that also holds the current
+    // one; a transition to the current state or a parent of it leaves and
+    // re-enters the target
+    const State *common = target->parent;
+    while (common && !contains(common, current))
+    {
+      common = common->parent;
+    }
+
+    for (const State *s = current; s && s != common; s = s->parent)
+    {
+      s->handler(*this, SIG_EXIT);
+    }
+
+    const State *path[STATE_MAX_DEPTH];
+    uint8_t depth = 0;
+    for (const State *s = target; s && s != common && depth < STATE_MAX_DEPTH; s = s->parent)
+    {
+      path[depth++] = s;
+    }
+
+    // Entry actions may ask for another transition; the last one wins and
+    // is taken once the target is fully entered
+    while (depth > 0)
+    {
+      current = path[--depth];
+      if (onEnter)
+      {
+        onEnter(*this, current->id);
+      }
+      current->handler(*this, SIG_ENTRY);
+    }
+  }
+}
@@ -0,0 +1,135 @@
+#include "Telemetry.h"
+
+Telemetry::Telemetry()
+    : port(0), head(0), tail(0), droppedFrames(0), messageTap(0), reportDrops(false), source(0), markedSource(0),
+      textChannel(*this)
+{
+}
+
+void Telemetry::begin(HardwareSerial &serialPort, unsigned long baud)
+{
+  port = &serialPort;
+  port->begin(baud);
+  send(EV_BOOT);
+}
+
+bool Telemetry::send(TelemetryEvent event, const uint8_t *payload, uint8_t length)
+{
+  // Only count the marker as sent once it is queued, so a dropped one is
+  // sent again
+  if (source != markedSource && event != EV_ARM && send(EV_ARM, source))
+  {
+    markedSource = source;
+  }
+
+  if (length > TELEMETRY_MAX_PAYLOAD)
+  {
+    length = TELEMETRY_MAX_PAYLOAD;
+  }
+
+  uint8_t message[TELEMETRY_MAX_MESSAGE];
+  uint32_t now = micros();
+  message[0] = event;
+  message[1] = (uint8_t)now;
+  message[2] = (uint8_t)(now >> 8);
+  message[3] = (uint8_t)(now >> 16);
+  message[4] = (uint8_t)(now >> 24);
+  if (messageTap)
+  {
+    messageTap(event, now, payload, length);
+  }
+  for (uint8_t i = 0; i < length; i++)
+  {
+    message[TELEMETRY_HEADER_SIZE + i] = payload[i];
+  }
+  uint8_t body = TELEMETRY_HEADER_SIZE + length;
+  uint16_t crc = telemetryCrc16(message, body);
+  message[body] = (uint8_t)crc;
+  message[body + 1] = (uint8_t)(crc >> 8);
+
+  uint8_t frame[TELEMETRY_MAX_FRAME];
+  size_t frameLength = cobsEncode(message, body + TELEMETRY_CRC_SIZE, frame);
+  frame[frameLength++] = 0;
+
+  // Keep one slot free so head == tail always means empty
+  uint16_t space = TELEMETRY_RING_SIZE - 1 - queued();
+  if (frameLength > space)
+  {
+    droppedFrames++;
+    reportDrops = true;
+    return false;
+  }
+
+  for (size_t i = 0; i < frameLength; i++)
+  {
+    ring[head] = frame[i];
+    head = (head + 1) % TELEMETRY_RING_SIZE;
+  }
+  return true;
+}
+
+bool Telemetry::send(TelemetryEvent event, uint8_t value)
+{
+  return send(event, &value, 1);
+}
+
+bool Telemetry::send(TelemetryEvent event, uint8_t first, uint8_t second)
+{
+  uint8_t payload[2] = {first, second};
+  return send(event, payload, sizeof(payload));
+}
+
+void Telemetry::flush()
+{
+  if (!port)
+  {
+    return;
+  }
+
+  // Let the host know about lost frames once there is room again
+  if (reportDrops && queued() < TELEMETRY_RING_SIZE / 2)
+  {
+    reportDrops = false;
+    uint32_t count = droppedFrames;
+    uint8_t payload[4] = {(uint8_t)count, (uint8_t)(count >> 8),
+                          (uint8_t)(count >> 16), (uint8_t)(count >> 24)};
+    send(EV_DROPPED, payload, sizeof(payload));
+  }
+
+  int room = port->availableForWrite();
+  while (room-- > 0 && tail != head)
+  {
+    port->write(ring[tail]);
+    tail = (tail + 1) % TELEMETRY_RING_SIZE;
+  }
+}
+
+uint16_t Telemetry::queued() const
+{
+  return (head + TELEMETRY_RING_SIZE - tail) % TELEMETRY_RING_SIZE;
+}
+
+Telemetry::TextChannel::TextChannel(Telemetry &owner)
+    : telemetry(owner), length(0)
+{
+}
+
+size_t Telemetry::TextChannel::write(uint8_t c)
+{
+  if (c == '\r')
+  {
+    return 1;
+  }
+
+  if (c != '\n')
+  {
+    line[length++] = c;
+  }
+
+  if (c == '\n' || length == sizeof(line))
+  {
+    telemetry.send(EV_TEXT, line, length);
+    length = 0;
+  }
+  return 1;
+}
@@ -0,0 +1,144 @@
+#include "ServoBackend.h"
+
+#if SERVO_BACKEND == SERVO_BACKEND_TIMER_PWM
+
+#include <util/atomic.h>
+
+// Servo library defaults, so angles map to the same pulses as before
+static const int SERVO_MIN_PULSE_US = 544;
+static const int SERVO_MAX_PULSE_US = 2400;
+
+// 16 MHz / 8 = 2 ticks per microsecond, 40000 ticks per 20 ms frame
+static const uint16_t TICKS_PER_US = 2;
+static const uint16_t FRAME_TOP = 40000 - 1;
+
+struct ServoTimer
+{
+  volatile uint8_t *tccrA;
+  volatile uint8_t *tccrB;
+  volatile uint16_t *icr;
+  volatile uint16_t *tcnt;
+  volatile uint16_t *ocr[3];
+};
+
+static const ServoTimer servoTimers[] = {
+    {&TCCR1A, &TCCR1B, &ICR1, &TCNT1, {&OCR1A, &OCR1B, &OCR1C}},
+    {&TCCR3A, &TCCR3B, &ICR3, &TCNT3, {&OCR3A, &OCR3B, &OCR3C}},
+    {&TCCR4A, &TCCR4B, &ICR4, &TCNT4, {&OCR4A, &OCR4B, &OCR4C}},
+    {&TCCR5A, &TCCR5B, &ICR5, &TCNT5, {&OCR5A, &OCR5B, &OCR5C}}};
+
+// Output-compare pins, indexed by timer then channel A/B/C
+static const uint8_t servoTimerPins[4][3] = {
+    {11, 12, 13},
+    {5, 2, 3},
+    {6, 7, 8},
+    {46, 45, 44}};
+
+// COMnx1 (non-inverting PWM) for channels A, B and C; same bit positions on
+// every timer
+static const uint8_t compareOutputBits[3] = {(1 << COM1A1), (1 << COM1B1), (1 << COM1C1)};
+
+// Timers already switched to the 20 ms servo frame
+static uint8_t timersStarted = 0;
+
+static void startTimer(uint8_t timer)
+{
+  if (timersStarted & (1 << timer))
+  {
+    return;
+  }
+  const ServoTimer &t = servoTimers[timer];
+
+  // Fast PWM with TOP in ICRn (mode 14), clock / 8, all outputs off until
+  // their servo is attached
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    *t.tccrB = 0;
+    *t.tccrA = (1 << WGM11);
+    *t.icr = FRAME_TOP;
+    *t.tcnt = 0;
+    *t.tccrB = (1 << WGM13) | (1 << WGM12) | (1 << CS11);
+  }
+  timersStarted |= 1 << timer;
+}
+
+TimerServo::TimerServo()
+    : pin(TIMER_SERVO_INVALID), timer(0), channel(0), minPulseUs(SERVO_MIN_PULSE_US),
+      maxPulseUs(SERVO_MAX_PULSE_US), angle(90), isAttached(false)
+{
+}
+
+uint8_t TimerServo::attach(int servoPin)
+{
+  return attach(servoPin, SERVO_MIN_PULSE_US, SERVO_MAX_PULSE_US);
+}
+
+uint8_t TimerServo::attach(int servoPin, int minUs, int maxUs)
+{
+  for (uint8_t t = 0; t < 4; t++)
+  {
+    for (uint8_t c = 0; c < 3; c++)
+    {
+      if (servoTimerPins[t][c] != servoPin)
+      {
+        continue;
+      }
+
+      pin = (uint8_t)servoPin;
+      timer = t;
+      channel = c;
+      minPulseUs = minUs;
+      maxPulseUs = maxUs;
+      startTimer(t);
+
+      // Load the width before the output is enabled so the first pulse is
+      // already right, like the Servo library resuming at the last angle
+      isAttached = true;
+      write(angle);
+      pinMode(pin, OUTPUT);
+      ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+      {
+        *servoTimers[t].tccrA |= compareOutputBits[c];
+      }
+      return pin;
+    }
+  }
+  return TIMER_SERVO_INVALID;
+}
+
+void TimerServo::detach()
+{
+  if (!isAttached)
+  {
+    return;
+  }
+  isAttached = false;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    *servoTimers[timer].tccrA &= ~compareOutputBits[channel];
+  }
+  digitalWrite(pin, LOW);
+}
+
+void TimerServo::write(int newAngle)
+{
+  angle = constrain(newAngle, 0, 180);
+  writeMicroseconds(map(angle, 0, 180, minPulseUs, maxPulseUs));
+}
+
+void TimerServo::writeMicroseconds(int pulseUs)
+{
+  if (!isAttached)
+  {
+    return;
+  }
+  uint16_t ticks = (uint16_t)constrain(pulseUs, minPulseUs, maxPulseUs) * TICKS_PER_US;
+
+  // 16-bit register writes go through the shared TEMP byte
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+  {
+    *servoTimers[timer].ocr[channel] = ticks;
+  }
+}
+
+#endif
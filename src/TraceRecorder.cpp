@@ -0,0 +1,40 @@
+#include "TraceRecorder.h"
+
+TraceRecorder::TraceRecorder(Telemetry &output)
+    : out(output), recording(false), cycleStart(false), label(COLOR_UNKNOWN)
+{
+}
+
+void TraceRecorder::begin(bool enabled)
+{
+  recording = enabled;
+  cycleStart = false;
+  label = COLOR_UNKNOWN;
+}
+
+void TraceRecorder::record(uint32_t startUs, uint16_t durationMs, const ColorReading &reading,
+                           uint16_t clear, uint8_t scalePercent, uint8_t flags)
+{
+  if (!recording)
+  {
+    return;
+  }
+
+  TraceSample sample;
+  sample.startUs = startUs;
+  sample.durationMs = durationMs;
+  sample.reading = reading;
+  sample.clear = clear;
+  sample.scalePercent = scalePercent;
+  sample.label = label;
+  sample.flags = flags;
+  if (cycleStart)
+  {
+    sample.flags |= TRACE_FLAG_CYCLE_START;
+    cycleStart = false;
+  }
+
+  uint8_t buffer[TRACE_RECORD_SIZE];
+  encodeTraceRecord(sample, buffer);
+  out.send(EV_TRACE, buffer, TRACE_RECORD_SIZE);
+}
@@ -0,0 +1,30 @@
+#include "Watchdog.h"
+
+#ifdef __AVR__
+static uint8_t savedResetFlags __attribute__((section(".noinit")));
+
+// Runs from .init3 like paintStack() (PerfCounters.cpp), and uses no stack
+void saveResetFlags() __attribute__((naked, used, section(".init3")));
+void saveResetFlags()
+{
+  savedResetFlags = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
+}
+#endif
+
+void watchdogBegin()
+{
+#ifdef __AVR__
+  wdt_enable(WDTO_1S);
+#endif
+}
+
+uint8_t resetFlags()
+{
+#ifdef __AVR__
+  return savedResetFlags;
+#else
+  return 0;
+#endif
+}
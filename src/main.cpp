@@ -1,494 +1,578 @@
-#include <Servo.h>
 #include <Arduino.h>
+#include "CellBus.h"
+#include "Checkpoint.h"
+#include "CommandShell.h"
+#include "EventLog.h"
+#include "JointLimits.h"
+#include "Log.h"
+#include "PerfCounters.h"
+#include "Scheduler.h"
+#include "ServoBackend.h"
+#include "SorterStation.h"
+#include "Telemetry.h"
+#include "TraceRecorder.h"
+#include "Watchdog.h"
+
+// Arms driven from this board, each a complete sorter with its own servos,
+// color sensor, poses and cycle (see SorterStation.h). Build with
+// -DARM_COUNT=2 for two.
+#ifndef ARM_COUNT
+#define ARM_COUNT 1
+#endif
+
+// Where each arm is wired: base, arm, joint, grabber 1 and grabber 2 servo
+// pins (PCA9685 channels with SERVO_BACKEND_PCA9685), the color sensor's
+// S0, S1, S2, S3 and output pins, then the grip feedback switch, if any.
+// Servo 1 is the base (0=forward, 90=left, 180=toward me), servo 3 the
+// second arm segment (0=left, 140=right for grabbing), servo 4 the joint
+// between arm and grabber (90=for picking, 0=for lifting), servos 5 and 6
+// the grabber (90=initial, 150=optimal position; 0-70 range as tested).
+const StationPins armPins[] = {
+#if SERVO_BACKEND == SERVO_BACKEND_PCA9685
+    {{0, 1, 2, 3, 4}, 2, 4, 7, 8, 12, GRIP_FEEDBACK_NONE},
+    {{5, 6, 7, 8, 9}, 30, 31, 32, 33, 34, GRIP_FEEDBACK_NONE},
+#elif SERVO_BACKEND == SERVO_BACKEND_TIMER_PWM
+    // Pin 9 is on the 8-bit Timer2, so the base moves to OC5A. The others
+    // are already compare outputs: 11 = OC1A, 6 = OC4A, 5 = OC3A, 3 = OC3C.
+    // The sensor uses the remaining outputs on 2, 7, 8 and 12, so there is
+    // no room for a second arm.
+    {{46, 11, 6, 5, 3}, 2, 4, 7, 8, 12, GRIP_FEEDBACK_NONE},
+#else
+    {{9, 11, 6, 5, 3}, 2, 4, 7, 8, 12, GRIP_FEEDBACK_NONE},
+    {{22, 23, 24, 25, 26}, 30, 31, 32, 33, 34, GRIP_FEEDBACK_NONE},
+#endif
+};
+
+static_assert(ARM_COUNT >= 1 && ARM_COUNT <= sizeof(armPins) / sizeof(armPins[0]),
+              "ARM_COUNT needs a row in armPins for every arm");
+
+// Everything goes out as binary telemetry frames (see TelemetryFormat.h).
+// 250000 baud divides the 16 MHz clock exactly. Frames are queued in a ring
+// buffer that drains from yield(), so logging never blocks the motion.
+// With more than one arm, EV_ARM says which arm the frames after it are from.
+const unsigned long serialBaud = 250000;
+Telemetry telemetry;
+
+// Stream binary sensor traces for tools/trace_replay (see TraceRecorder.h)
+const bool traceRecording = false;
+TraceRecorder traceRecorder(telemetry);
+
+// The last events before a reset, dumped with the "events" command. Lives
+// in .noinit so a watchdog or reset-button restart doesn't clear it.
+EventLog eventLog __attribute__((section(".noinit")));
+
+// Loop timing, blocking time, ISR load and memory, queried with "stats" and
+// sent as EV_STATS at the end of every cycle
+PerfCounters perf;
+
+// Each arm's poses, and the timing and sensing settings they share
+ArmPoses armPoses[ARM_COUNT];
+SorterSettings settings;
+
+// The arms. Each one checkpoints its pose and cycle phase in its own share
+// of the EEPROM ring at CHECKPOINT_EEPROM_ADDRESS; after a reset with a
+// valid checkpoint it skips the self-test and homing.
+SorterStation stations[ARM_COUNT] = {
+    {0, armPins[0], armPoses[0], settings, telemetry, perf, traceRecorder},
+#if ARM_COUNT > 1
+    {1, armPins[1], armPoses[1], settings, telemetry, perf, traceRecorder},
+#endif
+};
+
+const uint8_t checkpointSlots = CHECKPOINT_SLOTS / ARM_COUNT;
+
+// Cell bus to the line's host dispatcher (see BusFormat.h and
+// tools/cell_dispatcher), on Serial1 (pins 18/19). On the bus, the arms
+// don't look for objects themselves: the host reads every object on the
+// shared feed, assigns it to a cell with room and throttles the feed when
+// none has any. Each cell on the line needs its own address. busEnablePin
+// drives an RS-485 transceiver's DE and /RE pins.
+const bool cellBus = false;
+const uint8_t cellAddress = 1;
+const uint8_t busEnablePin = BUS_NO_ENABLE_PIN;
+CellBus bus;
+
+// Motion stepping, color scanning, the sorting cycle, telemetry and the
+// command interface each run as a task (see setup()), for every arm at once
+Scheduler scheduler;
+
+// Pose parameters of one arm. The first arm's have no prefix.
+#define POSE_PARAMS(prefix, poses)                                                                                 \
+  {prefix "baseBluePos", &poses.baseBluePos, JOINT_LIMITS[SERVO_BASE].minAngle, JOINT_LIMITS[SERVO_BASE].maxAngle},    \
+  {prefix "baseRedPos", &poses.baseRedPos, JOINT_LIMITS[SERVO_BASE].minAngle, JOINT_LIMITS[SERVO_BASE].maxAngle},      \
+  {prefix "baseGreenPos", &poses.baseGreenPos, JOINT_LIMITS[SERVO_BASE].minAngle, JOINT_LIMITS[SERVO_BASE].maxAngle},  \
+  {prefix "baseObjectPos", &poses.baseObjectPos, JOINT_LIMITS[SERVO_BASE].minAngle, JOINT_LIMITS[SERVO_BASE].maxAngle}, \
+  {prefix "grabberOpenPos", &poses.grabberOpenPos, JOINT_LIMITS[SERVO_GRABBER2].minAngle,                           \
+   JOINT_LIMITS[SERVO_GRABBER2].maxAngle},                                                                          \
+  {prefix "grabberClosedPos", &poses.grabberClosedPos, JOINT_LIMITS[SERVO_GRABBER2].minAngle,                       \
+   JOINT_LIMITS[SERVO_GRABBER2].maxAngle},                                                                          \
+  {prefix "jointPickPos", &poses.jointPickPos, JOINT_LIMITS[SERVO_JOINT].minAngle, JOINT_LIMITS[SERVO_JOINT].maxAngle}, \
+  {prefix "jointLiftPos", &poses.jointLiftPos, JOINT_LIMITS[SERVO_JOINT].minAngle, JOINT_LIMITS[SERVO_JOINT].maxAngle}, \
+  {prefix "grabber1RestPos", &poses.grabber1RestPos, JOINT_LIMITS[SERVO_GRABBER1].minAngle,                         \
+   JOINT_LIMITS[SERVO_GRABBER1].maxAngle},                                                                          \
+  {prefix "grabber1PickPos", &poses.grabber1PickPos, JOINT_LIMITS[SERVO_GRABBER1].minAngle,                         \
+   JOINT_LIMITS[SERVO_GRABBER1].maxAngle},                                                                          \
+  {prefix "armPickPos", &poses.armPickPos, JOINT_LIMITS[SERVO_ARM].minAngle, JOINT_LIMITS[SERVO_ARM].maxAngle},        \
+  {prefix "armMidPos", &poses.armMidPos, JOINT_LIMITS[SERVO_ARM].minAngle, JOINT_LIMITS[SERVO_ARM].maxAngle},          \
+  {prefix "armRestPos", &poses.armRestPos, JOINT_LIMITS[SERVO_ARM].minAngle, JOINT_LIMITS[SERVO_ARM].maxAngle},        \
+  {prefix "armReleasePos", &poses.armReleasePos, JOINT_LIMITS[SERVO_ARM].minAngle, JOINT_LIMITS[SERVO_ARM].maxAngle}
+
+// Everything above that can be tuned at runtime over the command interface.
+// The second arm's poses are "1.baseBluePos" and so on.
+const ParamInfo paramTable[] PROGMEM = {
+    POSE_PARAMS("", armPoses[0]),
+#if ARM_COUNT > 1
+    POSE_PARAMS("1.", armPoses[1]),
+#endif
+    {"moveDelayMs", &settings.moveDelayMs, 1, 100},
+    {"baseMoveDelayMs", &settings.baseMoveDelayMs, 1, 100},
+    {"stepDwellMs", &settings.stepDwellMs, 0, 10000},
+    {"attachDwellMs", &settings.attachDwellMs, 0, 10000},
+    {"settleDwellMs", &settings.settleDwellMs, 0, 10000},
+    {"retryDwellMs", &settings.retryDwellMs, 0, 10000},
+    {"cycleDwellMs", &settings.cycleDwellMs, 0, 10000},
+    {"idleDwellMs", &settings.idleDwellMs, 0, 10000},
+    {"maxAttempts", &settings.maxAttempts, 1, 20},
+    {"sensorDeadlineMs", &settings.sensorDeadlineMs, SENSOR_DEADLINE_MIN_MS, 5000},
+    {"armSenseAbortPos", &settings.armSenseAbortPos, 0, 180},
+    {"approachPresenceMax", &settings.approachPresenceMax, 0, 30000},
+    {"powerIdleMs", &settings.powerIdleMs, 0, 30000},
+    {"powerLeadMs", &settings.powerLeadMs, 0, 1000},
+    {"feedTravelMs", &settings.feedTravelMs, 0, 30000},
+    {"gripRetries", &settings.gripRetries, 0, 5}};
+
+// Saved parameters (see CommandShell::eepromSize()) have to stay clear of
+// the checkpoint ring
+static_assert(PARAMS_EEPROM_ADDRESS + 3 + 2 * (sizeof(paramTable) / sizeof(paramTable[0])) + 1 <=
+                  CHECKPOINT_EEPROM_ADDRESS,
+              "parameter table runs into the checkpoint ring");
+
+bool handleCommand(const char *command, char *args, Print &out);
+CommandShell commandShell(Serial, telemetry.text(), paramTable, sizeof(paramTable) / sizeof(paramTable[0]));
+
+// Copy every telemetry event into the event log
+void logEvent(TelemetryEvent event, uint32_t timeUs, const uint8_t *payload, uint8_t length)
+{
+  eventLog.record(event, timeUs, payload, length);
+}
 
-// Create servo objects
-Servo baseServo;     // Servo 1: Base - rotates horizontally (0=forward, 90=left, 180=toward me)
-Servo armServo2;     // Servo 3: Second arm segment (0=left, 140=right for grabbing)
-Servo jointServo;    // Servo 4: Joint between arm and grabber (90=for picking, 0=for lifting)
-Servo grabberServo1; // Servo 5: Grabber part 1 (90=initial, 150=optimal position)
-Servo grabberServo2; // Servo 6: Grabber part 2 (using 0-70 range as tested)
-
-// Define pins
-const int baseServoPin = 9;
-const int armServo2Pin = 11;
-const int jointServoPin = 6;
-const int grabberServo1Pin = 5;
-const int grabberServo2Pin = 3;
-
-// Color sensor pins
-const int S0 = 2;
-const int S1 = 4;
-const int S2 = 7;
-const int S3 = 8;
-const int sensorOut = 12;
-
-// Base positions
-const int baseBluePos = 90;  // Left position (blue drop location)
-const int baseRedPos = 60;   // Middle-left position (red drop location)
-const int baseGreenPos = 30; // Middle-right position (green drop location)
-const int baseObjectPos = 0; // Forward position (object pickup)
-
-// Grabber positions
-const int grabberOpenPos = 70;  // Open position (based on your test code)
-const int grabberClosedPos = 0; // Closed position (based on your test code)
-
-// Joint positions
-const int jointPickPos = 90; // Joint position for picking objects
-const int jointLiftPos = 0;  // Joint position for lifting objects
-
-// Arm positions
-const int armPickPos = 140;    // Arm position for picking objects
-const int armMidPos = 60;      // Arm mid position
-const int armRestPos = 0;      // Arm rest position
-const int armReleasePos = 120; // Safe release position
-
-// Color frequency readings
-int redFreq = 0;
-int greenFreq = 0;
-int blueFreq = 0;
-
-// Detected color
-String detectedColor = "unknown";
-int targetBasePosition = baseBluePos; // Default to blue position
-boolean objectDetected = false;
-
-// Function to move servo gradually with safety checks
-void moveServoGradually(Servo &servo, int startAngle, int endAngle, int delayMs)
+// delay() calls yield() while it waits; use that to drain telemetry and
+// pick up commands if anything still blocks
+void yield()
 {
-  if (startAngle < endAngle)
+  telemetry.flush();
+  commandShell.poll();
+}
+
+// The last BUS_ASSIGN answered, so a repeat of it is acknowledged again
+// instead of queuing the object twice
+struct BusAssignAnswer
+{
+  bool valid;
+  uint8_t sequence;
+  uint8_t color;
+  uint8_t arm;
+  unsigned long atMs;
+};
+BusAssignAnswer lastAssign = {false, 0, 0, 0, 0};
+
+// Function to answer the host dispatcher: status for a poll, and objects
+// go to the arm with the fewest already queued
+uint8_t handleBusRequest(uint8_t command, const uint8_t *payload, uint8_t length, uint8_t *reply,
+                         uint8_t &replyCommand)
+{
+  if (command == BUS_POLL)
   {
-    for (int angle = startAngle; angle <= endAngle; angle++)
+    uint8_t queued = 0;
+    uint8_t room = 0;
+    unsigned long sorted = 0;
+    unsigned long lastMs = 0;
+    unsigned int dropped = 0;
+    for (uint8_t i = 0; i < ARM_COUNT; i++)
     {
-      servo.write(angle);
-      delay(delayMs);
+      queued += stations[i].objectsQueued();
+      room += stations[i].queueRoom();
+      sorted += stations[i].objectsSorted();
+      lastMs = max(lastMs, stations[i].lastCycleMs());
+      dropped += stations[i].objectsDropped();
     }
+    uint16_t cycleMs = lastMs > 0xFFFF ? 0xFFFF : (uint16_t)lastMs;
+    reply[0] = ARM_COUNT;
+    reply[1] = queued;
+    reply[2] = room;
+    reply[3] = (uint8_t)sorted;
+    reply[4] = (uint8_t)(sorted >> 8);
+    reply[5] = (uint8_t)(sorted >> 16);
+    reply[6] = (uint8_t)(sorted >> 24);
+    reply[7] = (uint8_t)cycleMs;
+    reply[8] = (uint8_t)(cycleMs >> 8);
+    reply[9] = (uint8_t)dropped;
+    reply[10] = (uint8_t)(dropped >> 8);
+    replyCommand = BUS_STATUS;
+    return 11;
   }
-  else
+  if (command == BUS_ASSIGN && length >= 4)
   {
-    for (int angle = startAngle; angle >= endAngle; angle--)
+    replyCommand = BUS_ACK;
+    reply[0] = payload[0];
+    if (lastAssign.valid && payload[0] == lastAssign.sequence && payload[1] == lastAssign.color &&
+        millis() - lastAssign.atMs < BUS_REPEAT_WINDOW_MS)
+    {
+      reply[1] = lastAssign.arm;
+      return 2;
+    }
+
+    Color color = (Color)payload[1];
+    unsigned long travelMs = (unsigned long)payload[2] | ((unsigned long)payload[3] << 8);
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < ARM_COUNT; i++)
     {
-      servo.write(angle);
-      delay(delayMs);
+      if (stations[i].objectsQueued() < stations[best].objectsQueued())
+      {
+        best = i;
+      }
     }
+    bool accepted = (color == COLOR_RED || color == COLOR_GREEN || color == COLOR_BLUE) &&
+                    stations[best].assignObject(color, travelMs);
+    reply[1] = accepted ? best : BUS_REJECTED;
+    lastAssign.valid = true;
+    lastAssign.sequence = payload[0];
+    lastAssign.color = payload[1];
+    lastAssign.arm = reply[1];
+    lastAssign.atMs = millis();
+    return 2;
   }
+  return 0;
 }
 
-// Function to detect color using TCS3200 sensor
-boolean detectObject()
+// Function to label each arm's part of a report, when there is more than one
+void printArmHeading(Print &out, uint8_t arm)
 {
-  // Set sensor to read red color
-  digitalWrite(S2, LOW);
-  digitalWrite(S3, LOW);
-  delay(150); // Slightly increased delay for stability
-  redFreq = pulseIn(sensorOut, LOW);
-  Serial.print("Red: ");
-  Serial.println(redFreq);
-
-  // Set sensor to read green color
-  digitalWrite(S2, HIGH);
-  digitalWrite(S3, HIGH);
-  delay(150); // Slightly increased delay for stability
-  greenFreq = pulseIn(sensorOut, LOW);
-  Serial.print("Green: ");
-  Serial.println(greenFreq);
-
-  // Set sensor to read blue color
-  digitalWrite(S2, LOW);
-  digitalWrite(S3, HIGH);
-  delay(150); // Slightly increased delay for stability
-  blueFreq = pulseIn(sensorOut, LOW);
-  Serial.print("Blue: ");
-  Serial.println(blueFreq);
-
-  // Check if readings are within valid range
-  const int MIN_VALID = 0;
-  const int MAX_VALID = 116;
-
-  bool validRed = (redFreq >= MIN_VALID && redFreq <= MAX_VALID);
-  bool validGreen = (greenFreq >= MIN_VALID && greenFreq <= MAX_VALID);
-  bool validBlue = (blueFreq >= MIN_VALID && blueFreq <= MAX_VALID);
-
-  Serial.print("Valid readings - Red: ");
-  Serial.print(validRed ? "Yes" : "No");
-  Serial.print(", Green: ");
-  Serial.print(validGreen ? "Yes" : "No");
-  Serial.print(", Blue: ");
-  Serial.println(validBlue ? "Yes" : "No");
-
-  // First check if any readings are valid
-  if (!validRed && !validGreen && !validBlue)
+  if (ARM_COUNT > 1)
   {
-    Serial.println("UNKNOWN (all readings out of valid range)");
-    return false; // No valid object detected
-  }
-
-  // Find the minimum frequency among valid readings
-  int minFreq = 999; // Start with high value
-  String minColor = "none";
-
-  if (validRed)
-  {
-    minFreq = redFreq;
-    minColor = "red";
+    out.print(F("arm "));
+    out.println(arm);
   }
+}
 
-  if (validGreen && greenFreq < minFreq)
+// Function to handle the firmware's own commands:
+//   label r|g|b|n|?   set the true color of the objects being traced
+//   stats [reset]     show (or clear) the performance counters
+//   tasks [reset]     show (or clear) the scheduler's per-task timing
+//   power [reset]     show (or clear) the servo duty-cycle statistics
+//   joints            show each servo's commanded angle, speed and power
+//   selftest          run the grabber test and full homing sequence now
+//   grip [reset]      show (or clear) how many grabs held the object
+//   feed [clear]      show (or empty) the objects queued by the upstream sensor
+//                     or the host dispatcher; also shows the cell bus counters
+//   events [clear]    dump (or clear) the in-RAM event log, oldest first
+// The per-servo reports cover every arm, and selftest runs on all of them.
+bool handleCommand(const char *command, char *args, Print &out)
+{
+  if (strcmp_P(command, PSTR("events")) == 0)
   {
-    minFreq = greenFreq;
-    minColor = "green";
+    if (args && strcmp_P(args, PSTR("clear")) == 0)
+    {
+      eventLog.clear();
+    }
+    out.print(F("events: "));
+    out.print(eventLog.count());
+    out.print(F(", boots: "));
+    out.println(eventLog.boots());
+    for (uint8_t i = 0; i < eventLog.count(); i++)
+    {
+      // The dump is larger than the telemetry ring; let it drain as we go
+      while (telemetry.queued() > TELEMETRY_RING_SIZE / 2)
+      {
+        telemetry.flush();
+      }
+      eventLog.printEntry(out, i);
+    }
+    return true;
   }
-
-  if (validBlue && blueFreq < minFreq)
+  if (strcmp_P(command, PSTR("stats")) == 0)
   {
-    minFreq = blueFreq;
-    minColor = "blue";
+    if (args && strcmp_P(args, PSTR("reset")) == 0)
+    {
+      perf.reset();
+    }
+    perf.measureIsrLoad();
+    perf.print(out);
+    return true;
   }
-
-  // Now check if the minimum is significantly lower than others (using 0.9 factor)
-  bool redDominant = validRed && (redFreq == minFreq) &&
-                     (!validGreen || redFreq < greenFreq * 0.9) &&
-                     (!validBlue || redFreq < blueFreq * 0.9);
-
-  bool greenDominant = validGreen && (greenFreq == minFreq) &&
-                       (!validRed || greenFreq < redFreq * 0.9) &&
-                       (!validBlue || greenFreq < blueFreq * 0.9);
-
-  bool blueDominant = validBlue && (blueFreq == minFreq) &&
-                      (!validRed || blueFreq < redFreq * 0.9) &&
-                      (!validGreen || blueFreq < greenFreq * 0.9);
-
-  // Set the detected color and target position
-  if (redDominant)
+  if (strcmp_P(command, PSTR("tasks")) == 0)
   {
-    Serial.println("Detected RED object (within range and dominant)");
-    detectedColor = "red";
-    targetBasePosition = baseRedPos;
-    return true; // Object detected
+    if (args && strcmp_P(args, PSTR("reset")) == 0)
+    {
+      scheduler.resetStats();
+    }
+    scheduler.print(out);
+    return true;
   }
-  else if (greenDominant)
+  if (strcmp_P(command, PSTR("power")) == 0)
   {
-    Serial.println("Detected GREEN object (within range and dominant)");
-    detectedColor = "green";
-    targetBasePosition = baseGreenPos;
-    return true; // Object detected
+    bool reset = args && strcmp_P(args, PSTR("reset")) == 0;
+    for (uint8_t i = 0; i < ARM_COUNT; i++)
+    {
+      if (reset)
+      {
+        stations[i].resetPowerStats();
+      }
+      printArmHeading(out, i);
+      stations[i].printPower(out);
+    }
+    return true;
   }
-  else if (blueDominant)
+  if (strcmp_P(command, PSTR("joints")) == 0)
   {
-    Serial.println("Detected BLUE object (within range and dominant)");
-    detectedColor = "blue";
-    targetBasePosition = baseBluePos;
-    return true; // Object detected
+    for (uint8_t i = 0; i < ARM_COUNT; i++)
+    {
+      printArmHeading(out, i);
+      stations[i].printJoints(out);
+    }
+    return true;
   }
-  else
+  if (strcmp_P(command, PSTR("feed")) == 0)
   {
-    Serial.print("Ambiguous - lowest valid color is ");
-    Serial.print(minColor);
-    Serial.println(" but not clearly dominant");
-    detectedColor = "unknown";
-    return false; // No clear color detected, wait for better reading
+    bool clear = args && strcmp_P(args, PSTR("clear")) == 0;
+    for (uint8_t i = 0; i < ARM_COUNT; i++)
+    {
+      if (clear)
+      {
+        stations[i].clearFeed();
+      }
+      printArmHeading(out, i);
+      stations[i].printFeed(out);
+    }
+    if (cellBus)
+    {
+      bus.print(out);
+    }
+    return true;
   }
-}
-
-// Function to move to initial position
-void moveToInitialPosition()
-{
-  // Make sure grabberServo2 is attached
-  grabberServo2.attach(grabberServo2Pin);
-
-  // Set base to object position (forward)
-  baseServo.write(baseObjectPos);
-  delay(1000);
-
-  // Set arm to rest position
-  armServo2.write(armRestPos);
-  delay(1000);
-
-  // Set joint to pick position (90 degrees)
-  jointServo.write(jointPickPos);
-  delay(1000);
-
-  // Set grabberServo1 to initial position
-  grabberServo1.write(90);
-  delay(1000);
-
-  // Close grabber
-  for (int angle = grabberOpenPos; angle >= grabberClosedPos; angle--)
+  if (strcmp_P(command, PSTR("grip")) == 0)
   {
-    grabberServo2.write(angle);
-    delay(15);
+    bool reset = args && strcmp_P(args, PSTR("reset")) == 0;
+    for (uint8_t i = 0; i < ARM_COUNT; i++)
+    {
+      if (reset)
+      {
+        stations[i].resetGripStats();
+      }
+      printArmHeading(out, i);
+      stations[i].printGrip(out);
+    }
+    return true;
   }
-  delay(1000);
-
-  Serial.println("Initial position set");
-}
-
-// Function to pick up object
-void pickUpObject()
-{
-  Serial.println("PICKING UP OBJECT");
-
-  // Make sure grabberServo2 is attached
-  grabberServo2.attach(grabberServo2Pin);
-  Serial.println("Grabber servo attached");
-  delay(500);
-
-  // 1. Move arm to middle position (60)
-  Serial.println("Moving arm to middle position");
-  moveServoGradually(armServo2, armRestPos, armMidPos, 15);
-  delay(1000);
-
-  // 2. Move grabberServo1 to optimal position
-  Serial.println("Adjusting grabber position");
-  moveServoGradually(grabberServo1, 90, 150, 15);
-  delay(1000);
-
-  // 3. Open grabber
-  Serial.println("Opening grabber");
-  for (int angle = grabberClosedPos; angle <= grabberOpenPos; angle++)
+  if (strcmp_P(command, PSTR("selftest")) == 0)
   {
-    grabberServo2.write(angle);
-    delay(15);
+    for (uint8_t i = 0; i < ARM_COUNT; i++)
+    {
+      stations[i].requestSelfTest();
+    }
+    out.println(F("selftest: starting"));
+    return true;
   }
-  delay(1000);
-
-  // 4. Move arm to picking position (140)
-  Serial.println("Moving arm to picking position");
-  moveServoGradually(armServo2, armMidPos, armPickPos, 15);
-  delay(1000);
-
-  // 5. Wait for a valid object with identifiable color
-  // Try up to 5 times with a 1-second delay between attempts
-  Serial.println("Checking for object with identifiable color...");
-  int attempts = 0;
-  const int maxAttempts = 5;
-
-  while (attempts < maxAttempts)
+  if (strcmp_P(command, PSTR("label")) == 0)
   {
-    objectDetected = detectObject();
-
-    if (objectDetected)
+    Color label = COLOR_UNKNOWN;
+    switch (args ? args[0] : '?')
     {
-      Serial.println("Valid object detected!");
-      break; // Exit the loop if object detected
+    case 'r':
+      label = COLOR_RED;
+      break;
+    case 'g':
+      label = COLOR_GREEN;
+      break;
+    case 'b':
+      label = COLOR_BLUE;
+      break;
+    case 'n':
+      label = COLOR_NONE;
+      break;
+    default:
+      break;
     }
+    traceRecorder.setLabel(label);
+    out.print(F("label="));
+    out.println(colorName(label));
+    return true;
+  }
+  return false;
+}
 
-    attempts++;
-    if (attempts < maxAttempts)
+// Tasks run by the scheduler. Each one does its share of the work for
+// every arm in turn.
+void motionTask()
+{
+  bool stepped = false;
+  bool idle = true;
+  for (uint8_t i = 0; i < ARM_COUNT; i++)
+  {
+    if (stations[i].updateMotion())
     {
-      Serial.print("No valid object detected. Waiting... (Attempt ");
-      Serial.print(attempts);
-      Serial.print(" of ");
-      Serial.print(maxAttempts);
-      Serial.println(")");
-      delay(1000); // Wait before trying again
+      stepped = true;
     }
+    idle = idle && stations[i].motionIdle();
   }
-
-  if (!objectDetected)
+  if (stepped)
   {
-    Serial.println("No valid object detected after multiple attempts. Returning to start position.");
-    // Return to mid position
-    moveServoGradually(armServo2, armPickPos, armMidPos, 15);
-    delay(1000);
-
-    // Return to rest position
-    moveServoGradually(armServo2, armMidPos, armRestPos, 15);
-    delay(1000);
-
-    // Reset grabberServo1
-    moveServoGradually(grabberServo1, 150, 90, 15);
-    delay(1000);
-    return;
+    perf.motionUpdate();
   }
-
-  // 6. Close grabber to grab object
-  Serial.println("Closing grabber to grab object");
-  for (int angle = grabberOpenPos; angle >= grabberClosedPos; angle--)
+  if (idle)
   {
-    grabberServo2.write(angle);
-    delay(15);
+    perf.motionEnd();
   }
-  delay(1000);
-
-  // 7. Detach grabber servo to prevent overheating and servo strain while holding
-  Serial.println("Detaching grabber servo to prevent overheating");
-  grabberServo2.detach();
-  delay(1000);
-
-  // 8. Move arm back to middle position
-  Serial.println("Moving arm to middle position");
-  moveServoGradually(armServo2, armPickPos, armMidPos, 15);
-  delay(1000);
-
-  // 9. Move arm to rest position (0)
-  Serial.println("Moving arm to rest position");
-  moveServoGradually(armServo2, armMidPos, armRestPos, 15);
-  delay(1000);
-
-  // 10. Move joint to lifting position (0) using gradual movement
-  Serial.println("Moving joint to lifting position");
-  moveServoGradually(jointServo, jointPickPos, jointLiftPos, 15);
-  delay(1000);
-
-  // 11. Move base to position based on detected color
-  Serial.print("Moving base to ");
-  Serial.print(detectedColor);
-  Serial.print(" position (");
-  Serial.print(targetBasePosition);
-  Serial.println(" degrees)");
-  moveServoGradually(baseServo, baseObjectPos, targetBasePosition, 20);
-  delay(2000);
 }
 
-// Function to release object
-void releaseObject()
+void scanTask()
 {
-  // Only proceed if an object was detected and grabbed
-  if (!objectDetected)
+  for (uint8_t i = 0; i < ARM_COUNT; i++)
   {
-    Serial.println("No object to release. Skipping release sequence.");
-    return;
+    stations[i].updateScan();
   }
+}
 
-  Serial.println("RELEASING OBJECT");
-
-  // 1. Move arm to middle position (60)
-  Serial.println("Moving arm to middle position");
-  moveServoGradually(armServo2, armRestPos, armMidPos, 15);
-  delay(1000);
+void cycleTask()
+{
+  for (uint8_t i = 0; i < ARM_COUNT; i++)
+  {
+    stations[i].updateCycle();
+  }
+}
 
-  // 2. Return joint to pick position (90)
-  Serial.println("Moving joint to picking position");
-  moveServoGradually(jointServo, jointLiftPos, jointPickPos, 15);
-  delay(1000);
+void telemetryTask()
+{
+  telemetry.flush();
+}
 
-  // 3. Move arm to release position (120, safer than 140)
-  Serial.println("Moving arm to release position");
-  moveServoGradually(armServo2, armMidPos, armReleasePos, 15);
-  delay(1000);
+void commandTask()
+{
+  commandShell.poll();
+  commandShell.update();
+}
 
-  // 4. Reattach grabber servo
-  Serial.println("Reattaching grabber servo");
-  grabberServo2.attach(grabberServo2Pin);
-  delay(1000);
+void busTask()
+{
+  bus.update();
+}
 
-  // 5. Open grabber to release object
-  Serial.println("Opening grabber to release object");
-  for (int angle = grabberClosedPos; angle <= grabberOpenPos; angle++)
+void powerTask()
+{
+  for (uint8_t i = 0; i < ARM_COUNT; i++)
   {
-    grabberServo2.write(angle);
-    delay(15);
+    stations[i].updatePower();
   }
-  delay(2000);
-
-  // 6. Move arm back to middle position
-  Serial.println("Moving arm to middle position");
-  moveServoGradually(armServo2, armReleasePos, armMidPos, 15);
-  delay(1000);
+}
 
-  // 7. Close grabber
-  Serial.println("Closing grabber");
-  for (int angle = grabberOpenPos; angle >= grabberClosedPos; angle--)
+void checkpointTask()
+{
+  for (uint8_t i = 0; i < ARM_COUNT; i++)
   {
-    grabberServo2.write(angle);
-    delay(15);
+    stations[i].updateCheckpoint();
   }
-  delay(1000);
-
-  // 8. Reset grabberServo1 to initial position
-  Serial.println("Resetting grabber position");
-  moveServoGradually(grabberServo1, 150, 90, 15);
-  delay(1000);
-
-  // 9. Move arm back to rest position
-  Serial.println("Moving arm to rest position");
-  moveServoGradually(armServo2, armMidPos, armRestPos, 15);
-  delay(1000);
+}
 
-  // 10. Move base back to object position
-  Serial.println("Moving base to object position");
-  moveServoGradually(baseServo, targetBasePosition, baseObjectPos, 20);
-  delay(2000);
+// The ISR load sample busy-waits for up to two servo frames (~45 ms), so it
+// is taken about every isrSampleMs, at the first chance when no arm is
+// moving or reading its sensor
+const unsigned long isrSampleMs = 10000;
+unsigned long lastIsrSampleMs = 0;
 
-  // 11. Detach grabber servo until next cycle
-  Serial.println("Detaching grabber servo until next cycle");
-  grabberServo2.detach();
+void isrLoadTask()
+{
+  if (millis() - lastIsrSampleMs < isrSampleMs)
+  {
+    return;
+  }
+  for (uint8_t i = 0; i < ARM_COUNT; i++)
+  {
+    if (!stations[i].quiet())
+    {
+      return;
+    }
+  }
+  perf.measureIsrLoad();
+  lastIsrSampleMs = millis();
+}
 
-  // Reset object detection flag
-  objectDetected = false;
+void servoFrameTask()
+{
+  flushServos();
 }
 
 void setup()
 {
+  // Keep the event log from before the reset and note why we restarted
+  uint8_t resetCause = resetFlags();
+  eventLog.begin(resetCause);
+
   // Initialize serial communication
-  Serial.begin(9600);
-  Serial.println("Starting Robotic Arm with Color Sensor Setup");
-
-  // Set color sensor pins as OUTPUT
-  pinMode(S0, OUTPUT);
-  pinMode(S1, OUTPUT);
-  pinMode(S2, OUTPUT);
-  pinMode(S3, OUTPUT);
-
-  // Set sensor OUT pin as INPUT
-  pinMode(sensorOut, INPUT);
-
-  // Set color sensor frequency scaling to 20%
-  digitalWrite(S0, HIGH);
-  digitalWrite(S1, LOW);
-
-  // Attach all servos
-  Serial.println("Attaching servos...");
-  baseServo.attach(baseServoPin);
-  armServo2.attach(armServo2Pin);
-  jointServo.attach(jointServoPin);
-  grabberServo1.attach(grabberServo1Pin);
-  grabberServo2.attach(grabberServo2Pin);
-
-  // Test grabberServo2 first to verify it's working
-  Serial.println("Testing grabber servo 2...");
-  for (int angle = 0; angle <= 70; angle++)
+  telemetry.begin(Serial, serialBaud);
+  telemetry.setTap(logEvent);
+  logBegin(telemetry.text());
+
+  // Restore tuned parameters saved with the "save" command
+  commandShell.setHandler(handleCommand);
+  if (commandShell.load())
   {
-    grabberServo2.write(angle);
-    delay(15);
+    LOG_INFO(F("Loaded saved parameters"));
+  }
+  LOG_INFO(F("Starting Robotic Arm with Color Sensor Setup"));
+  if (watchdogReset())
+  {
+    LOG_WARN(F("Restarted by the watchdog"));
   }
-  delay(1000);
 
-  for (int angle = 70; angle >= 0; angle--)
+  traceRecorder.begin(traceRecording);
+  if (!beginServos())
   {
-    grabberServo2.write(angle);
-    delay(15);
+    LOG_ERROR(F("Servo controller not responding"));
   }
-  delay(1000);
 
-  // Set initial positions
-  moveToInitialPosition();
+  // Attach every arm's servos and start its cycle, each with its own share
+  // of the checkpoint space
+  for (uint8_t i = 0; i < ARM_COUNT; i++)
+  {
+    int checkpointAddress = CHECKPOINT_EEPROM_ADDRESS + i * Checkpoint::eepromSize(checkpointSlots);
+    stations[i].begin(checkpointAddress, checkpointSlots, cellBus);
+  }
+  if (cellBus)
+  {
+    bus.setHandler(handleBusRequest);
+    bus.begin(Serial1, cellAddress, busEnablePin);
+  }
 
-  Serial.println("Robotic Arm Ready!");
-  delay(2000);
+  // Motion steps every millisecond and goes first. A sensor pulse can hold
+  // the others up by a few ms (up to ~14 ms at 2% scaling), so the scanning
+  // and cycle deadlines are looser.
+  scheduler.add(F("motion"), motionTask, 1000, 1000, 4);
+  scheduler.add(F("scan"), scanTask, 2000, 20000, 3);
+  scheduler.add(F("cycle"), cycleTask, 1000, 20000, 2);
+  scheduler.add(F("telemetry"), telemetryTask, 1000, 5000, 1);
+  scheduler.add(F("command"), commandTask, 10000, 50000, 0);
+  if (cellBus)
+  {
+    // Well inside the host's reply timeout, even behind a sensor pulse
+    scheduler.add(F("bus"), busTask, 2000, 20000, 1);
+  }
+  scheduler.add(F("power"), powerTask, 10000, 20000, 1);
+  // An EEPROM byte takes 3.3 ms to write; one per run never waits for it
+  scheduler.add(F("checkpoint"), checkpointTask, 5000, 50000, 0);
+  scheduler.add(F("isr load"), isrLoadTask, 100000, 100000, 0);
+#if SERVO_BACKEND == SERVO_BACKEND_PCA9685
+  // One I2C burst per 20 ms servo frame, right after the motion steps
+  scheduler.add(F("servo frame"), servoFrameTask, 20000, 20000, 4);
+#endif
+  scheduler.begin();
+
+  // From here on a hang resets the board within a second
+  watchdogBegin();
 }
 
 void loop()
 {
-  Serial.println("Waiting for object...");
-
-  // Complete pick and place cycle
-  pickUpObject();
-  delay(1000);
-
-  // Only release if we actually picked something up
-  if (objectDetected)
-  {
-    releaseObject();
-    delay(1000);
-
-    Serial.println("Cycle complete - waiting before next cycle");
-    delay(3000);
-  }
-  else
-  {
-    // If no object was detected, wait a bit before trying again
-    Serial.println("No object detected - waiting before trying again");
-    delay(2000);
-  }
-}
\ No newline at end of file
+  perf.loopTick();
+  watchdogFeed();
+  scheduler.runOnce();
+}
@@ -0,0 +1,31 @@
+#ifndef FAKE_ARDUINO_H
+#define FAKE_ARDUINO_H
+
+// Just enough of the Arduino core to build driver code on the host for the
+// native tests
+
+#include <stddef.h>
+#include <stdint.h>
+
+template <typename T> inline T min(T a, T b)
+{
+  return b < a ? b : a;
+}
+
+template <typename T> inline T max(T a, T b)
+{
+  return a < b ? b : a;
+}
+
+#define constrain(x, low, high) ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+inline void delayMicroseconds(unsigned int)
+{
+}
+
+#endif
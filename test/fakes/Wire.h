@@ -0,0 +1,60 @@
+#ifndef FAKE_WIRE_H
+#define FAKE_WIRE_H
+
+#include <Arduino.h>
+#include <vector>
+
+// Stand-in for the Arduino TwoWire that keeps every transaction written to
+// it, so a test can check exactly what went out on the bus
+class TwoWire
+{
+public:
+  TwoWire() : clockHz(0), nack(false), address(0) {}
+
+  void begin() {}
+  void setClock(unsigned long hz) { clockHz = hz; }
+
+  void beginTransmission(uint8_t deviceAddress)
+  {
+    address = deviceAddress;
+    bytes.clear();
+  }
+
+  size_t write(uint8_t value)
+  {
+    bytes.push_back(value);
+    return 1;
+  }
+
+  // 0 on success, 2 (address NACK) when nack is set. A NACKed transaction
+  // isn't recorded.
+  uint8_t endTransmission()
+  {
+    if (nack)
+    {
+      return 2;
+    }
+    transactions.push_back(bytes);
+    addresses.push_back(address);
+    return 0;
+  }
+
+  void clear()
+  {
+    transactions.clear();
+    addresses.clear();
+  }
+
+  unsigned long clockHz;
+  bool nack;
+  std::vector<std::vector<uint8_t> > transactions;
+  std::vector<uint8_t> addresses;
+
+private:
+  uint8_t address;
+  std::vector<uint8_t> bytes;
+};
+
+extern TwoWire Wire;
+
+#endif
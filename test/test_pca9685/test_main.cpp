@@ -0,0 +1,185 @@
+// Host tests for the PCA9685 driver (src/Pca9685.cpp), run with
+// "pio test -e native". Every I2C transaction goes to the fake TwoWire in
+// test/fakes, which keeps the bytes so they can be checked one by one.
+
+#include <unity.h>
+
+#include "ServoBackend.h"
+
+TwoWire Wire;
+
+static Pca9685 *pca;
+
+// Bytes of a burst holding channels first..last
+static size_t burstSize(uint8_t first, uint8_t last)
+{
+  return 1 + 4 * (last - first + 1);
+}
+
+// The four register bytes of channel in a burst that starts at first
+static uint16_t onTicks(const std::vector<uint8_t> &burst, uint8_t first, uint8_t channel)
+{
+  size_t at = 1 + 4 * (channel - first);
+  return (uint16_t)(burst[at] | (burst[at + 1] << 8));
+}
+
+static uint16_t offTicks(const std::vector<uint8_t> &burst, uint8_t first, uint8_t channel)
+{
+  size_t at = 1 + 4 * (channel - first);
+  return (uint16_t)(burst[at + 2] | (burst[at + 3] << 8));
+}
+
+void setUp()
+{
+  Wire = TwoWire();
+  pca = new Pca9685(Wire);
+  TEST_ASSERT_TRUE(pca->begin());
+}
+
+void tearDown()
+{
+  delete pca;
+}
+
+void test_begin_sets_prescale_for_50_hz()
+{
+  // 25 MHz / (4096 * 50 Hz), rounded, minus one
+  bool found = false;
+  for (size_t i = 0; i < Wire.transactions.size(); i++)
+  {
+    const std::vector<uint8_t> &t = Wire.transactions[i];
+    if (t.size() == 2 && t[0] == PCA9685_PRE_SCALE)
+    {
+      TEST_ASSERT_EQUAL_UINT8(121, t[1]);
+      found = true;
+    }
+  }
+  TEST_ASSERT_TRUE(found);
+  TEST_ASSERT_EQUAL_UINT32(400000, Wire.clockHz);
+  TEST_ASSERT_EQUAL_UINT8(PCA9685_DEFAULT_ADDRESS, Wire.addresses[0]);
+}
+
+void test_begin_turns_every_channel_off_in_bursts_of_seven()
+{
+  // Four register writes, then channels 0-6, 7-13 and 14-15
+  TEST_ASSERT_EQUAL(7, Wire.transactions.size());
+  const uint8_t firsts[] = {0, 7, 14};
+  const uint8_t lasts[] = {6, 13, 15};
+  for (uint8_t b = 0; b < 3; b++)
+  {
+    const std::vector<uint8_t> &burst = Wire.transactions[4 + b];
+    TEST_ASSERT_EQUAL(burstSize(firsts[b], lasts[b]), burst.size());
+    TEST_ASSERT_EQUAL_UINT8(PCA9685_LED0_ON_L + 4 * firsts[b], burst[0]);
+    for (uint8_t channel = firsts[b]; channel <= lasts[b]; channel++)
+    {
+      TEST_ASSERT_EQUAL_UINT16((uint16_t)PCA9685_FULL_OFF << 8, offTicks(burst, firsts[b], channel));
+    }
+  }
+  TEST_ASSERT_EQUAL(3, pca->bursts());
+  TEST_ASSERT_EQUAL(2 * burstSize(0, 6) + burstSize(14, 15), pca->bytesSent());
+}
+
+void test_no_burst_is_longer_than_the_wire_buffer()
+{
+  Wire.clear();
+  pca->setPulse(0, 1500);
+  pca->setPulse(15, 1500);
+  TEST_ASSERT_TRUE(pca->flush());
+  TEST_ASSERT_EQUAL(3, Wire.transactions.size());
+  for (size_t i = 0; i < Wire.transactions.size(); i++)
+  {
+    TEST_ASSERT_TRUE(Wire.transactions[i].size() <= 1 + 4 * PCA9685_CHANNELS_PER_BURST);
+  }
+}
+
+void test_pulses_start_staggered_across_the_frame()
+{
+  Wire.clear();
+  for (uint8_t channel = 0; channel < 5; channel++)
+  {
+    pca->setPulse(channel, 1500);
+  }
+  TEST_ASSERT_TRUE(pca->flush());
+  TEST_ASSERT_EQUAL(1, Wire.transactions.size());
+
+  // 1500 us is 307 ticks of (121 + 1) / 25 MHz, after each channel's start
+  const std::vector<uint8_t> &burst = Wire.transactions[0];
+  for (uint8_t channel = 0; channel < 5; channel++)
+  {
+    TEST_ASSERT_EQUAL_UINT16(channel * 256, onTicks(burst, 0, channel));
+    TEST_ASSERT_EQUAL_UINT16(channel * 256 + 307, offTicks(burst, 0, channel));
+  }
+}
+
+void test_only_changed_channels_are_sent()
+{
+  Wire.clear();
+  pca->setPulse(2, 1000);
+  pca->setPulse(4, 2000);
+  TEST_ASSERT_TRUE(pca->flush());
+
+  // One burst from the lowest to the highest changed channel
+  TEST_ASSERT_EQUAL(1, Wire.transactions.size());
+  TEST_ASSERT_EQUAL(burstSize(2, 4), Wire.transactions[0].size());
+  TEST_ASSERT_EQUAL_UINT8(PCA9685_LED0_ON_L + 4 * 2, Wire.transactions[0][0]);
+
+  // Nothing changed, nothing sent
+  Wire.clear();
+  TEST_ASSERT_TRUE(pca->flush());
+  pca->setPulse(2, 1000);
+  TEST_ASSERT_TRUE(pca->flush());
+  TEST_ASSERT_EQUAL(0, Wire.transactions.size());
+}
+
+void test_failed_flush_is_retried()
+{
+  Wire.clear();
+  Wire.nack = true;
+  pca->setPulse(3, 1500);
+  TEST_ASSERT_FALSE(pca->flush());
+
+  Wire.nack = false;
+  TEST_ASSERT_TRUE(pca->flush());
+  TEST_ASSERT_EQUAL(1, Wire.transactions.size());
+  TEST_ASSERT_EQUAL(burstSize(3, 3), Wire.transactions[0].size());
+  TEST_ASSERT_EQUAL_UINT16(768 + 307, offTicks(Wire.transactions[0], 3, 3));
+}
+
+void test_detach_holds_the_channel_full_off()
+{
+  Pca9685Servo::setController(*pca);
+  Pca9685Servo servo;
+  servo.attach(1);
+  servo.write(90);
+  Wire.clear();
+  TEST_ASSERT_TRUE(pca->flush());
+  TEST_ASSERT_EQUAL(1, Wire.transactions.size());
+  // 90 degrees is 1472 us with the Servo library's 544-2400 us range
+  TEST_ASSERT_EQUAL_UINT16(256 + 301, offTicks(Wire.transactions[0], 1, 1));
+
+  Wire.clear();
+  servo.detach();
+  TEST_ASSERT_TRUE(pca->flush());
+  TEST_ASSERT_EQUAL(1, Wire.transactions.size());
+  TEST_ASSERT_EQUAL_UINT16((uint16_t)PCA9685_FULL_OFF << 8, offTicks(Wire.transactions[0], 1, 1));
+  TEST_ASSERT_FALSE(servo.attached());
+
+  // Writes while detached don't wake it
+  Wire.clear();
+  servo.write(45);
+  TEST_ASSERT_TRUE(pca->flush());
+  TEST_ASSERT_EQUAL(0, Wire.transactions.size());
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_begin_sets_prescale_for_50_hz);
+  RUN_TEST(test_begin_turns_every_channel_off_in_bursts_of_seven);
+  RUN_TEST(test_no_burst_is_longer_than_the_wire_buffer);
+  RUN_TEST(test_pulses_start_staggered_across_the_frame);
+  RUN_TEST(test_only_changed_channels_are_sent);
+  RUN_TEST(test_failed_flush_is_retried);
+  RUN_TEST(test_detach_holds_the_channel_full_off);
+  return UNITY_END();
+}
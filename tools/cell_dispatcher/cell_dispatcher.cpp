@@ -0,0 +1,509 @@
+// Host-side dispatcher for a line of sorting cells sharing one cell bus.
+//
+// The line's upstream color sensor (or whatever classifies objects before
+// they reach the cells) writes one color per line to stdin as each object
+// goes past: "red", "green" or "blue". The dispatcher assigns every object
+// to the cell that will get to it soonest, judging by how many objects each
+// cell already has queued and how long its cycles take, and tells that cell
+// how long the object takes to reach its pick position.
+//
+//   g++ -std=c++11 -O2 -Iinclude -o cell_dispatcher
+//       tools/cell_dispatcher/cell_dispatcher.cpp
+//   ./upstream_sensor | ./cell_dispatcher -c 3 -t 4000,9000,14000 /dev/ttyUSB0
+//
+//   -c cells     cells on the bus, at addresses 1..cells (default 1)
+//   -t ms[,ms]   feed travel from the sensor to each cell's pick position;
+//                the last value is used for any cells after it (default 4000)
+//   -p ms        how often each cell is polled for its status (default 1000)
+//   -b baud      bus speed (default BUS_BAUD)
+//
+// When no cell has room left, the dispatcher stops reading stdin until one
+// has, so objects back up in the pipe instead of being lost; "feed hold" and
+// "feed run" go to stdout so a conveyor controller can follow along.
+// Per-cell statistics go to stderr every minute and on Ctrl-C.
+//
+// Without hardware, tools/cell_dispatcher/cell_standin.cpp emulates a line
+// of cells on a pseudo-terminal.
+
+#include <asm/termbits.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "BusFormat.h"
+#include "Color.h"
+
+namespace
+{
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void onSignal(int)
+{
+  stopRequested = 1;
+}
+
+// Put a tty in raw mode at any baud rate (termios2 allows non-standard
+// rates)
+bool configureSerial(int fd, unsigned long baud)
+{
+  struct termios2 tio;
+  if (ioctl(fd, TCGETS2, &tio) != 0)
+  {
+    return false;
+  }
+  tio.c_iflag = 0;
+  tio.c_oflag = 0;
+  tio.c_lflag = 0;
+  tio.c_cflag = CS8 | CREAD | CLOCAL | BOTHER;
+  tio.c_ispeed = baud;
+  tio.c_ospeed = baud;
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  return ioctl(fd, TCSETS2, &tio) == 0;
+}
+
+unsigned long nowMs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long)ts.tv_sec * 1000UL + (unsigned long)(ts.tv_nsec / 1000000);
+}
+
+// A cell goes offline after this many polls in a row go unanswered, and is
+// polled again as usual to bring it back
+const int offlineAfterMisses = 3;
+
+// Until a cell has finished a cycle, assume this long
+const unsigned long defaultCycleMs = 48000;
+
+const unsigned long reportIntervalMs = 60000;
+
+struct Cell
+{
+  Cell()
+      : address(0), travelMs(0), online(false), misses(0), arms(0), queued(0), room(0), sorted(0),
+        cycleMs(0), dropped(0), assigned(0), rejected(0), firstSorted(0), firstStatusMs(0), haveStatus(false)
+  {
+  }
+
+  uint8_t address;
+  unsigned long travelMs;
+  bool online;
+  int misses;
+
+  // As of the last BUS_STATUS, plus what has been assigned since
+  uint8_t arms;
+  uint8_t queued;
+  uint8_t room;
+  unsigned long sorted;
+  unsigned long cycleMs;
+  unsigned int dropped;
+
+  unsigned long assigned;
+  unsigned long rejected;
+  unsigned long firstSorted;
+  unsigned long firstStatusMs;
+  bool haveStatus;
+};
+
+class Dispatcher
+{
+public:
+  Dispatcher(int busFd, std::vector<Cell> &line)
+      : fd(busFd), cells(line), sequence(0), feedHeld(false), objects(0), unassigned(0), unconfirmed(0),
+        timeouts(0), startMs(nowMs())
+  {
+  }
+
+  // Send a request and wait for the addressed cell's answer
+  bool transact(Cell &cell, uint8_t command, const uint8_t *payload, uint8_t length, uint8_t expected,
+                std::vector<uint8_t> &reply)
+  {
+    uint8_t frame[BUS_MAX_FRAME];
+    size_t frameLength = busEncode(cell.address, BUS_HOST, command, payload, length, frame);
+    if (write(fd, frame, frameLength) != (ssize_t)frameLength)
+    {
+      std::perror("writing to the bus");
+      return false;
+    }
+
+    unsigned long deadline = nowMs() + BUS_REPLY_TIMEOUT_MS;
+    for (;;)
+    {
+      long left = (long)(deadline - nowMs());
+      if (left <= 0)
+      {
+        timeouts++;
+        return false;
+      }
+      struct pollfd p = {fd, POLLIN, 0};
+      if (poll(&p, 1, (int)left) <= 0)
+      {
+        continue;
+      }
+      uint8_t buffer[64];
+      ssize_t n = read(fd, buffer, sizeof(buffer));
+      if (n <= 0)
+      {
+        continue;
+      }
+      for (ssize_t i = 0; i < n; i++)
+      {
+        BusMessage message;
+        if (receiver.push(buffer[i], message) && message.destination == BUS_HOST &&
+            message.source == cell.address && message.command == expected)
+        {
+          reply.assign(message.payload, message.payload + message.payloadLength);
+          return true;
+        }
+      }
+    }
+  }
+
+  void pollCell(Cell &cell)
+  {
+    std::vector<uint8_t> reply;
+    if (!transact(cell, BUS_POLL, 0, 0, BUS_STATUS, reply) || reply.size() < 11)
+    {
+      if (++cell.misses >= offlineAfterMisses && cell.online)
+      {
+        cell.online = false;
+        std::fprintf(stderr, "cell %u offline\n", cell.address);
+      }
+      return;
+    }
+
+    if (!cell.online)
+    {
+      std::fprintf(stderr, "cell %u online\n", cell.address);
+    }
+    cell.online = true;
+    cell.misses = 0;
+    cell.arms = reply[0];
+    cell.queued = reply[1];
+    cell.room = reply[2];
+    cell.sorted = (unsigned long)reply[3] | ((unsigned long)reply[4] << 8) | ((unsigned long)reply[5] << 16) |
+                  ((unsigned long)reply[6] << 24);
+    unsigned long lastCycleMs = (unsigned long)(reply[7] | (reply[8] << 8));
+    if (lastCycleMs > 0)
+    {
+      cell.cycleMs = lastCycleMs;
+    }
+    cell.dropped = (unsigned int)(reply[9] | (reply[10] << 8));
+    if (!cell.haveStatus)
+    {
+      cell.haveStatus = true;
+      cell.firstSorted = cell.sorted;
+      cell.firstStatusMs = nowMs();
+    }
+  }
+
+  void pollAll()
+  {
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+      pollCell(cells[i]);
+    }
+    updateFeed();
+  }
+
+  // Pick a cell for an object sensed at sensedMs and hand it over. Cells are
+  // tried soonest free first; an object no cell can take in time is lost.
+  // An unanswered assignment goes to the same cell again with the same
+  // sequence number: it may only be the BUS_ACK that was lost, and the cell
+  // acknowledges a repeat without queuing the object twice. Only a
+  // BUS_REJECTED sends the object on to another cell.
+  void dispatch(Color color, unsigned long sensedMs)
+  {
+    objects++;
+    sequence++;
+    std::vector<bool> tried(cells.size(), false);
+    for (;;)
+    {
+      int best = -1;
+      unsigned long bestWaitMs = 0;
+      unsigned long elapsedMs = nowMs() - sensedMs;
+      for (size_t i = 0; i < cells.size(); i++)
+      {
+        const Cell &cell = cells[i];
+        if (tried[i] || !cell.online || cell.room == 0 || cell.travelMs < elapsedMs)
+        {
+          continue;
+        }
+        // Queued objects are shared between the cell's arms
+        unsigned long waitMs = (unsigned long)cell.queued * cycleEstimate(cell) / (cell.arms ? cell.arms : 1);
+        if (best < 0 || waitMs < bestWaitMs)
+        {
+          best = (int)i;
+          bestWaitMs = waitMs;
+        }
+      }
+      if (best < 0)
+      {
+        unassigned++;
+        std::fprintf(stderr, "no cell can take the %s object\n", colorNames[color]);
+        updateFeed();
+        return;
+      }
+
+      Cell &cell = cells[best];
+      tried[best] = true;
+      unsigned long travelMs = cell.travelMs - (nowMs() - sensedMs);
+      uint16_t inMs = travelMs > 0xFFFF ? 0xFFFF : (uint16_t)travelMs;
+      uint8_t payload[4] = {sequence, (uint8_t)color, (uint8_t)inMs, (uint8_t)(inMs >> 8)};
+      std::vector<uint8_t> reply;
+      bool answered = false;
+      for (uint8_t attempt = 0; attempt <= BUS_ASSIGN_RETRIES && !answered; attempt++)
+      {
+        answered = transact(cell, BUS_ASSIGN, payload, sizeof(payload), BUS_ACK, reply) && reply.size() >= 2 &&
+                   reply[0] == sequence;
+      }
+      if (!answered)
+      {
+        unconfirmed++;
+        std::fprintf(stderr, "cell %u never acknowledged the %s object\n", cell.address, colorNames[color]);
+        updateFeed();
+        return;
+      }
+      if (reply[1] == BUS_REJECTED)
+      {
+        cell.rejected++;
+        cell.room = 0;
+        continue;
+      }
+      cell.assigned++;
+      cell.queued++;
+      cell.room--;
+      updateFeed();
+      return;
+    }
+  }
+
+  bool held() const { return feedHeld; }
+
+  void report() const
+  {
+    unsigned long elapsed = nowMs() - startMs;
+    std::fprintf(stderr,
+                 "%lu objects in %lu s, %lu not assigned, %lu not acknowledged, %lu bus timeouts, %lu bad frames\n",
+                 objects, elapsed / 1000, unassigned, unconfirmed, timeouts, receiver.badFrames);
+    std::fprintf(stderr, "%4s %8s %4s %6s %4s %8s %8s %8s %8s %9s %7s\n", "cell", "state", "arms", "queued", "room",
+                 "assigned", "rejected", "sorted", "dropped", "cycle ms", "per min");
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+      const Cell &cell = cells[i];
+      double minutes = cell.haveStatus ? (nowMs() - cell.firstStatusMs) / 60000.0 : 0;
+      double perMinute = minutes > 0 ? (cell.sorted - cell.firstSorted) / minutes : 0;
+      std::fprintf(stderr, "%4u %8s %4u %6u %4u %8lu %8lu %8lu %8u %9lu %7.2f\n", cell.address,
+                   cell.online ? "online" : "offline", cell.arms, cell.queued, cell.room, cell.assigned,
+                   cell.rejected, cell.sorted, cell.dropped, cell.cycleMs, perMinute);
+    }
+  }
+
+  static const char *const colorNames[];
+
+private:
+  static unsigned long cycleEstimate(const Cell &cell) { return cell.cycleMs ? cell.cycleMs : defaultCycleMs; }
+
+  // Hold the feed while no cell has room, and let it run again once one has
+  void updateFeed()
+  {
+    bool room = false;
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+      room = room || (cells[i].online && cells[i].room > 0);
+    }
+    if (room == !feedHeld)
+    {
+      return;
+    }
+    feedHeld = !room;
+    std::printf(feedHeld ? "feed hold\n" : "feed run\n");
+    std::fflush(stdout);
+  }
+
+  int fd;
+  std::vector<Cell> &cells;
+  BusReceiver receiver;
+  uint8_t sequence;
+  bool feedHeld;
+  unsigned long objects;
+  unsigned long unassigned;
+  unsigned long unconfirmed;
+  unsigned long timeouts;
+  unsigned long startMs;
+};
+
+const char *const Dispatcher::colorNames[] = {"unknown", "red", "green", "blue", "none"};
+
+bool parseColor(const std::string &word, Color &color)
+{
+  for (int c = COLOR_RED; c <= COLOR_BLUE; c++)
+  {
+    if (word == Dispatcher::colorNames[c])
+    {
+      color = (Color)c;
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  unsigned long baud = BUS_BAUD;
+  unsigned long pollMs = 1000;
+  int cellCount = 1;
+  std::vector<unsigned long> travel(1, 4000);
+  int arg = 1;
+  while (arg + 1 < argc && argv[arg][0] == '-')
+  {
+    const char *value = argv[arg + 1];
+    if (std::strcmp(argv[arg], "-b") == 0)
+    {
+      baud = std::strtoul(value, 0, 10);
+    }
+    else if (std::strcmp(argv[arg], "-p") == 0)
+    {
+      pollMs = std::strtoul(value, 0, 10);
+    }
+    else if (std::strcmp(argv[arg], "-c") == 0)
+    {
+      cellCount = std::atoi(value);
+    }
+    else if (std::strcmp(argv[arg], "-t") == 0)
+    {
+      travel.clear();
+      for (char *end = (char *)value; *end;)
+      {
+        travel.push_back(std::strtoul(end, &end, 10));
+        if (*end == ',')
+        {
+          end++;
+        }
+        else if (*end)
+        {
+          break;
+        }
+      }
+    }
+    else
+    {
+      break;
+    }
+    arg += 2;
+  }
+  if (arg + 1 != argc || cellCount < 1 || cellCount >= BUS_BROADCAST || travel.empty())
+  {
+    std::fprintf(stderr, "usage: %s [-c cells] [-t ms[,ms...]] [-p poll ms] [-b baud] <serial-device>\n", argv[0]);
+    return 2;
+  }
+
+  const char *device = argv[arg];
+  int fd = open(device, O_RDWR | O_NOCTTY);
+  if (fd < 0)
+  {
+    std::perror(device);
+    return 1;
+  }
+  if (!configureSerial(fd, baud))
+  {
+    std::perror("configuring serial port");
+    return 1;
+  }
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  std::vector<Cell> cells(cellCount);
+  for (int i = 0; i < cellCount; i++)
+  {
+    cells[i].address = (uint8_t)(i + 1);
+    cells[i].travelMs = travel[i < (int)travel.size() ? i : travel.size() - 1];
+  }
+  std::fprintf(stderr, "dispatching to %d cells on %s at %lu baud, Ctrl-C to stop\n", cellCount, device, baud);
+
+  Dispatcher dispatcher(fd, cells);
+  dispatcher.pollAll();
+  unsigned long nextPollMs = nowMs() + pollMs;
+  unsigned long nextReportMs = nowMs() + reportIntervalMs;
+  std::string pending;
+  bool inputOpen = true;
+
+  while (!stopRequested)
+  {
+    // Only read objects while the feed runs, so a held feed backs up the pipe
+    long waitMs = (long)(nextPollMs - nowMs());
+    struct pollfd p = {STDIN_FILENO, POLLIN, 0};
+    bool reading = inputOpen && !dispatcher.held();
+    int ready = waitMs > 0 ? poll(&p, reading ? 1 : 0, (int)waitMs) : 0;
+    if (ready < 0 && errno != EINTR)
+    {
+      std::perror("poll");
+      break;
+    }
+
+    if (ready > 0)
+    {
+      char buffer[256];
+      ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+      if (n <= 0)
+      {
+        inputOpen = false; // Keep polling until Ctrl-C so the queued objects get sorted
+      }
+      else
+      {
+        pending.append(buffer, (size_t)n);
+      }
+    }
+
+    // One object at a time, stopping as soon as the feed is held: objects
+    // read in the same chunk are still waiting upstream and count as
+    // sensed when they are let through
+    size_t newline;
+    while (!dispatcher.held() && (newline = pending.find('\n')) != std::string::npos)
+    {
+      std::string word = pending.substr(0, newline);
+      pending.erase(0, newline + 1);
+      while (!word.empty() && (word[word.size() - 1] == '\r' || word[word.size() - 1] == ' '))
+      {
+        word.erase(word.size() - 1);
+      }
+      Color color;
+      if (parseColor(word, color))
+      {
+        dispatcher.dispatch(color, nowMs());
+      }
+      else if (!word.empty())
+      {
+        std::fprintf(stderr, "ignoring \"%s\"\n", word.c_str());
+      }
+    }
+
+    if ((long)(nowMs() - nextPollMs) >= 0)
+    {
+      dispatcher.pollAll();
+      nextPollMs = nowMs() + pollMs;
+    }
+    if ((long)(nowMs() - nextReportMs) >= 0)
+    {
+      dispatcher.report();
+      nextReportMs += reportIntervalMs;
+    }
+  }
+
+  dispatcher.report();
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,286 @@
+// Stand-in for a line of sorting cells, for trying out the cell bus and
+// tools/cell_dispatcher on a Linux box without any hardware.
+//
+// Opens a pseudo-terminal, prints the path of its far end and answers
+// BUS_POLL and BUS_ASSIGN on it for every emulated cell, just as the
+// firmware does with cellBus enabled. Each cell has one arm that takes the
+// oldest queued object once it has arrived and is busy for one cycle.
+//
+//   g++ -std=c++11 -O2 -Iinclude -o cell_standin
+//       tools/cell_dispatcher/cell_standin.cpp
+//   ./cell_standin -c 3 -y 20000,30000,48000
+//   yes red | pv -qL 4 | ./cell_dispatcher -c 3 -t 2000,4000,6000 /dev/pts/N
+//
+//   -c cells     cells to emulate, at addresses 1..cells (default 1)
+//   -y ms[,ms]   cycle time of each cell; the last value is used for any
+//                cells after it (default 48000)
+//   -q objects   feed queue size per cell (default 8, as FEED_QUEUE_SIZE)
+//   -l percent   BUS_ACK replies to lose, to try out the dispatcher's
+//                retries (default 0)
+//
+// Every frame is logged to stderr.
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "BusFormat.h"
+
+namespace
+{
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void onSignal(int)
+{
+  stopRequested = 1;
+}
+
+unsigned long nowMs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long)ts.tv_sec * 1000UL + (unsigned long)(ts.tv_nsec / 1000000);
+}
+
+struct FakeCell
+{
+  FakeCell()
+      : address(0), cycleMs(0), busy(false), busyUntilMs(0), sorted(0), lastCycleMs(0), dropped(0),
+        lastAssignValid(false), lastSequence(0), lastColor(0), lastAccepted(false), lastAssignMs(0)
+  {
+  }
+
+  // Finish the cycle in progress, then start on the next object if it has
+  // reached the pick position
+  void update(unsigned long now)
+  {
+    if (busy && (long)(now - busyUntilMs) >= 0)
+    {
+      busy = false;
+      sorted++;
+      lastCycleMs = cycleMs;
+    }
+    if (!busy && !arrivals.empty() && (long)(now - arrivals.front()) >= 0)
+    {
+      arrivals.pop_front();
+      busy = true;
+      busyUntilMs = now + cycleMs;
+    }
+  }
+
+  uint8_t address;
+  unsigned long cycleMs;
+  std::deque<unsigned long> arrivals;
+  bool busy;
+  unsigned long busyUntilMs;
+  unsigned long sorted;
+  unsigned long lastCycleMs;
+  unsigned int dropped;
+
+  // The last BUS_ASSIGN answered
+  bool lastAssignValid;
+  uint8_t lastSequence;
+  uint8_t lastColor;
+  bool lastAccepted;
+  unsigned long lastAssignMs;
+};
+
+void sendReply(int fd, const FakeCell &cell, uint8_t command, const uint8_t *payload, uint8_t length)
+{
+  uint8_t frame[BUS_MAX_FRAME];
+  size_t frameLength = busEncode(BUS_HOST, cell.address, command, payload, length, frame);
+  if (write(fd, frame, frameLength) != (ssize_t)frameLength)
+  {
+    std::perror("writing reply");
+  }
+}
+
+// Same answers as handleBusRequest() in the firmware
+void handleRequest(int fd, FakeCell &cell, const BusMessage &message, size_t queueSize, int losePercent)
+{
+  unsigned long now = nowMs();
+  cell.update(now);
+
+  if (message.command == BUS_POLL)
+  {
+    uint8_t room = (uint8_t)(queueSize - cell.arrivals.size());
+    uint16_t cycleMs = cell.lastCycleMs > 0xFFFF ? 0xFFFF : (uint16_t)cell.lastCycleMs;
+    uint8_t reply[11] = {1,
+                         (uint8_t)cell.arrivals.size(),
+                         room,
+                         (uint8_t)cell.sorted,
+                         (uint8_t)(cell.sorted >> 8),
+                         (uint8_t)(cell.sorted >> 16),
+                         (uint8_t)(cell.sorted >> 24),
+                         (uint8_t)cycleMs,
+                         (uint8_t)(cycleMs >> 8),
+                         (uint8_t)cell.dropped,
+                         (uint8_t)(cell.dropped >> 8)};
+    sendReply(fd, cell, BUS_STATUS, reply, sizeof(reply));
+    std::fprintf(stderr, "cell %u: poll, %u queued, %lu sorted\n", cell.address, reply[1], cell.sorted);
+    return;
+  }
+
+  if (message.command == BUS_ASSIGN && message.payloadLength >= 4)
+  {
+    const uint8_t *p = message.payload;
+    unsigned long travelMs = (unsigned long)(p[2] | (p[3] << 8));
+    bool repeat = cell.lastAssignValid && p[0] == cell.lastSequence && p[1] == cell.lastColor &&
+                  now - cell.lastAssignMs < BUS_REPEAT_WINDOW_MS;
+    bool accepted = repeat ? cell.lastAccepted : cell.arrivals.size() < queueSize && p[1] >= 1 && p[1] <= 3;
+    if (!repeat)
+    {
+      if (accepted)
+      {
+        cell.arrivals.push_back(now + travelMs);
+      }
+      else
+      {
+        cell.dropped++;
+      }
+      cell.lastAssignValid = true;
+      cell.lastSequence = p[0];
+      cell.lastColor = p[1];
+      cell.lastAccepted = accepted;
+      cell.lastAssignMs = now;
+    }
+    bool lost = std::rand() % 100 < losePercent;
+    if (!lost)
+    {
+      uint8_t reply[2] = {p[0], accepted ? (uint8_t)0 : BUS_REJECTED};
+      sendReply(fd, cell, BUS_ACK, reply, sizeof(reply));
+    }
+    std::fprintf(stderr, "cell %u: assign #%u color %u in %lu ms, %s%s%s\n", cell.address, p[0], p[1], travelMs,
+                 repeat ? "repeat, " : "", accepted ? "accepted" : "rejected", lost ? ", ack lost" : "");
+    return;
+  }
+
+  std::fprintf(stderr, "cell %u: unknown command 0x%02x\n", cell.address, message.command);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  int cellCount = 1;
+  size_t queueSize = 8;
+  int losePercent = 0;
+  std::vector<unsigned long> cycles(1, 48000);
+  int arg = 1;
+  while (arg + 1 < argc && argv[arg][0] == '-')
+  {
+    const char *value = argv[arg + 1];
+    if (std::strcmp(argv[arg], "-c") == 0)
+    {
+      cellCount = std::atoi(value);
+    }
+    else if (std::strcmp(argv[arg], "-q") == 0)
+    {
+      queueSize = (size_t)std::atoi(value);
+    }
+    else if (std::strcmp(argv[arg], "-l") == 0)
+    {
+      losePercent = std::atoi(value);
+    }
+    else if (std::strcmp(argv[arg], "-y") == 0)
+    {
+      cycles.clear();
+      for (char *end = (char *)value; *end;)
+      {
+        cycles.push_back(std::strtoul(end, &end, 10));
+        if (*end == ',')
+        {
+          end++;
+        }
+        else if (*end)
+        {
+          break;
+        }
+      }
+    }
+    else
+    {
+      break;
+    }
+    arg += 2;
+  }
+  if (arg != argc || cellCount < 1 || cellCount >= BUS_BROADCAST || queueSize < 1 || queueSize > 255 ||
+      cycles.empty() || losePercent < 0 || losePercent > 100)
+  {
+    std::fprintf(stderr, "usage: %s [-c cells] [-y ms[,ms...]] [-q objects] [-l percent]\n", argv[0]);
+    return 2;
+  }
+
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+  {
+    std::perror("opening a pseudo-terminal");
+    return 1;
+  }
+  const char *path = ptsname(master);
+
+  // Keep the far end open in raw mode, so nothing is echoed or translated
+  // and the dispatcher can come and go
+  int slave = open(path, O_RDWR | O_NOCTTY);
+  struct termios tio;
+  if (slave < 0 || tcgetattr(slave, &tio) != 0)
+  {
+    std::perror(path);
+    return 1;
+  }
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+
+  std::vector<FakeCell> cells(cellCount);
+  for (int i = 0; i < cellCount; i++)
+  {
+    cells[i].address = (uint8_t)(i + 1);
+    cells[i].cycleMs = cycles[i < (int)cycles.size() ? i : cycles.size() - 1];
+  }
+  std::printf("%s\n", path);
+  std::fflush(stdout);
+  std::fprintf(stderr, "%d cells on %s, Ctrl-C to stop\n", cellCount, path);
+
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+  BusReceiver receiver;
+  while (!stopRequested)
+  {
+    struct pollfd p = {master, POLLIN, 0};
+    if (poll(&p, 1, 100) <= 0)
+    {
+      continue;
+    }
+    uint8_t buffer[64];
+    ssize_t n = read(master, buffer, sizeof(buffer));
+    for (ssize_t i = 0; i < n; i++)
+    {
+      BusMessage message;
+      if (!receiver.push(buffer[i], message) || message.source != BUS_HOST)
+      {
+        continue;
+      }
+      for (size_t c = 0; c < cells.size(); c++)
+      {
+        if (message.destination == cells[c].address)
+        {
+          handleRequest(master, cells[c], message, queueSize, losePercent);
+        }
+      }
+    }
+  }
+
+  std::fprintf(stderr, "%lu bad frames\n", receiver.badFrames);
+  close(slave);
+  close(master);
+  return 0;
+}
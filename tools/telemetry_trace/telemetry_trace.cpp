@@ -0,0 +1,711 @@
+// Host-side telemetry decoder and timeline exporter.
+//
+// Reads the firmware's telemetry stream (see include/TelemetryFormat.h) from
+// a serial device or a capture file, rebuilds the per-cycle timeline and
+// writes it as Chrome trace-event JSON. Open the result in chrome://tracing
+// or https://ui.perfetto.dev to see where each cycle spends its time.
+//
+//   g++ -std=c++11 -O2 -Iinclude -o telemetry_trace
+//       tools/telemetry_trace/telemetry_trace.cpp
+//   ./telemetry_trace /dev/ttyACM0 cycles.json     (Ctrl-C to stop)
+//   ./telemetry_trace -b 250000 capture.bin cycles.json
+//
+// A per-cycle summary (moving / dwelling / sensing) goes to stderr. EV_STATS
+// frames become counter tracks. With several arms on one board, each gets
+// its own process in the timeline and its own summary table.
+
+#include <asm/termbits.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <vector>
+
+#include "TelemetryFormat.h"
+
+namespace
+{
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void onSignal(int)
+{
+  stopRequested = 1;
+}
+
+// Put a tty in raw mode at any baud rate (termios2 allows non-standard
+// rates such as the firmware's 250000)
+bool configureSerial(int fd, unsigned long baud)
+{
+  struct termios2 tio;
+  if (ioctl(fd, TCGETS2, &tio) != 0)
+  {
+    return false;
+  }
+  tio.c_iflag = 0;
+  tio.c_oflag = 0;
+  tio.c_lflag = 0;
+  tio.c_cflag = CS8 | CREAD | CLOCAL | BOTHER;
+  tio.c_ispeed = baud;
+  tio.c_ospeed = baud;
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  return ioctl(fd, TCSETS2, &tio) == 0;
+}
+
+const char *const servoNames[SERVO_COUNT] = {"base", "arm", "joint", "grabber1", "grabber2"};
+const char *const colorNames[] = {"unknown", "red", "green", "blue", "none"};
+const char *const resultNames[] = {"none", "object", "timeout"};
+const char *const sequenceNames[] = {"setup", "pick", "release"};
+const char *const stateNames[STATE_COUNT] = {"active", "homing", "idle", "approach", "sense", "grip", "transfer",
+                                             "release", "return", "return empty", "return from bin", "return to pick",
+                                             "resume", "recover"};
+
+// Timeline tracks (Chrome trace "threads")
+enum Track
+{
+  TRACK_CYCLE = 1,
+  TRACK_STATE,
+  TRACK_STEP,
+  TRACK_SENSE,
+  TRACK_DWELL,
+  TRACK_LOG,
+  TRACK_SERVO // One per servo from here on
+};
+
+const char *colorOf(uint8_t color)
+{
+  return color < 5 ? colorNames[color] : "?";
+}
+
+uint16_t u16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t u32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+std::string jsonEscape(const std::string &text)
+{
+  std::string out;
+  for (size_t i = 0; i < text.size(); i++)
+  {
+    char c = text[i];
+    if (c == '"' || c == '\\')
+    {
+      out += '\\';
+      out += c;
+    }
+    else if ((unsigned char)c < 0x20)
+    {
+      char buffer[8];
+      std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      out += buffer;
+    }
+    else
+    {
+      out += c;
+    }
+  }
+  return out;
+}
+
+// An open span waiting for its end event
+struct Span
+{
+  bool open;
+  double startUs;
+  std::string name;
+  std::string args;
+};
+
+struct CycleStats
+{
+  double startUs;
+  double endUs;
+  double movingUs;
+  double dwellUs;
+  double senseUs;
+  unsigned attempts;
+  std::string result;
+};
+
+// What is followed separately for each arm; EV_ARM says which one the
+// events after it belong to
+struct ArmTimeline
+{
+  ArmTimeline() : inCycle(false), movingSinceUs(0), cycleCount(0), gripChecks(0), gripsHeld(0)
+  {
+    for (int i = 0; i < SERVO_COUNT; i++)
+    {
+      moves[i].open = false;
+      servoMoving[i] = false;
+    }
+    state.open = false;
+    step.open = false;
+    dwell.open = false;
+    sense.open = false;
+    cycle.open = false;
+  }
+
+  std::vector<CycleStats> cycles;
+  CycleStats current;
+  bool inCycle;
+  double movingSinceUs;
+  unsigned long cycleCount;
+  Span cycle;
+  Span state;
+  Span step;
+  Span dwell;
+  Span sense;
+  Span moves[SERVO_COUNT];
+  bool servoMoving[SERVO_COUNT];
+  unsigned long gripChecks;
+  unsigned long gripsHeld;
+};
+
+class TimelineBuilder
+{
+public:
+  TimelineBuilder() : arms(1), arm(0), offsetUs(0), lastRawUs(0), lastUs(0), haveTime(false), frames(0), badFrames(0)
+  {
+  }
+
+  // Feed raw stream bytes
+  void feed(const uint8_t *data, size_t length)
+  {
+    for (size_t i = 0; i < length; i++)
+    {
+      if (data[i] != 0)
+      {
+        if (pending.size() <= TELEMETRY_MAX_FRAME)
+        {
+          pending.push_back(data[i]);
+        }
+        continue;
+      }
+      handleFrame();
+      pending.clear();
+    }
+  }
+
+  // Close whatever every arm still has open; the firmware starts over with
+  // the first arm after a boot
+  void finish()
+  {
+    for (arm = 0; arm < arms.size(); arm++)
+    {
+      ArmTimeline &a = arms[arm];
+      closeSpan(a.state, TRACK_STATE, lastUs);
+      closeSpan(a.step, TRACK_STEP, lastUs);
+      closeSpan(a.dwell, TRACK_DWELL, lastUs);
+      closeSpan(a.sense, TRACK_SENSE, lastUs);
+      for (int i = 0; i < SERVO_COUNT; i++)
+      {
+        closeSpan(a.moves[i], TRACK_SERVO + i, lastUs);
+      }
+      closeSpan(a.cycle, TRACK_CYCLE, lastUs);
+    }
+    arm = 0;
+  }
+
+  bool writeJson(const char *path) const
+  {
+    FILE *out = std::fopen(path, "w");
+    if (!out)
+    {
+      std::perror(path);
+      return false;
+    }
+
+    // One process per arm
+    std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    const char *trackNames[] = {"", "cycle", "state", "step", "sensing", "dwell", "log"};
+    for (size_t i = 0; i < arms.size(); i++)
+    {
+      int pid = (int)i + 1;
+      if (i > 0)
+      {
+        std::fprintf(out, ",\n");
+      }
+      for (int t = TRACK_CYCLE; t < TRACK_SERVO + SERVO_COUNT; t++)
+      {
+        const char *name = t < TRACK_SERVO ? trackNames[t] : servoNames[t - TRACK_SERVO];
+        std::fprintf(out, "{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"%s\"}},\n",
+                     pid, t, name);
+        std::fprintf(out, "{\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"name\":\"thread_sort_index\",\"args\":{\"sort_index\":%d}},\n",
+                     pid, t, t);
+      }
+      if (arms.size() == 1)
+      {
+        std::fprintf(out, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"sorting arm\"}}");
+      }
+      else
+      {
+        std::fprintf(out, "{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"arm %d\"}}", pid, (int)i);
+      }
+    }
+    for (size_t i = 0; i < events.size(); i++)
+    {
+      std::fprintf(out, ",\n%s", events[i].c_str());
+    }
+    std::fprintf(out, "\n]}\n");
+    std::fclose(out);
+    return true;
+  }
+
+  void printSummary() const
+  {
+    std::fprintf(stderr, "%lu frames (%lu corrupt)\n", frames, badFrames);
+    for (size_t n = 0; n < arms.size(); n++)
+    {
+      const ArmTimeline &a = arms[n];
+      if (arms.size() > 1)
+      {
+        std::fprintf(stderr, "arm %lu\n", (unsigned long)n);
+      }
+      std::fprintf(stderr, "%5s %10s %10s %10s %10s %8s  %s\n",
+                   "cycle", "total ms", "moving ms", "dwell ms", "sense ms", "attempts", "result");
+      for (size_t i = 0; i < a.cycles.size(); i++)
+      {
+        const CycleStats &c = a.cycles[i];
+        std::fprintf(stderr, "%5lu %10.1f %10.1f %10.1f %10.1f %8u  %s\n",
+                     (unsigned long)i + 1, (c.endUs - c.startUs) / 1000.0, c.movingUs / 1000.0,
+                     c.dwellUs / 1000.0, c.senseUs / 1000.0, c.attempts, c.result.c_str());
+      }
+      if (a.gripChecks > 0)
+      {
+        std::fprintf(stderr, "grip checks: %lu, held %lu (%.0f%%)\n", a.gripChecks, a.gripsHeld,
+                     100.0 * a.gripsHeld / a.gripChecks);
+      }
+    }
+  }
+
+private:
+  void handleFrame()
+  {
+    if (pending.empty())
+    {
+      return;
+    }
+
+    uint8_t message[TELEMETRY_MAX_FRAME];
+    size_t length = 0;
+    if (pending.size() <= TELEMETRY_MAX_FRAME)
+    {
+      length = cobsDecode(&pending[0], pending.size(), message);
+    }
+
+    TelemetryMessage parsed;
+    if (length == 0 || !parseTelemetryMessage(message, length, parsed))
+    {
+      badFrames++;
+      return;
+    }
+    frames++;
+    handleMessage(parsed);
+  }
+
+  // micros() wraps every ~71 minutes and restarts on every boot; keep the
+  // timeline monotonic across both
+  double unwrap(uint32_t rawUs, bool boot)
+  {
+    if (haveTime)
+    {
+      if (boot)
+      {
+        offsetUs = lastUs + 1000000.0 - rawUs;
+      }
+      else if (rawUs < lastRawUs && lastRawUs - rawUs > 0x80000000UL)
+      {
+        offsetUs += 4294967296.0;
+      }
+    }
+    haveTime = true;
+    lastRawUs = rawUs;
+    lastUs = offsetUs + rawUs;
+    return lastUs;
+  }
+
+  void complete(int track, double startUs, double endUs, const std::string &name, const std::string &args)
+  {
+    char buffer[160];
+    std::snprintf(buffer, sizeof(buffer), "{\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.0f,\"dur\":%.0f,\"name\":\"",
+                  (int)arm + 1, track, startUs, endUs - startUs);
+    std::string event = buffer;
+    event += jsonEscape(name);
+    event += "\"";
+    if (!args.empty())
+    {
+      event += ",\"args\":{" + args + "}";
+    }
+    event += "}";
+    events.push_back(event);
+  }
+
+  void instant(int track, double us, const std::string &name, const std::string &args = std::string())
+  {
+    char buffer[128];
+    std::snprintf(buffer, sizeof(buffer), "{\"ph\":\"i\",\"s\":\"t\",\"pid\":%d,\"tid\":%d,\"ts\":%.0f,\"name\":\"",
+                  (int)arm + 1, track, us);
+    std::string event = buffer;
+    event += jsonEscape(name);
+    event += "\"";
+    if (!args.empty())
+    {
+      event += ",\"args\":{" + args + "}";
+    }
+    event += "}";
+    events.push_back(event);
+  }
+
+  void counter(double us, const std::string &name, const std::string &args)
+  {
+    char buffer[96];
+    std::snprintf(buffer, sizeof(buffer), "{\"ph\":\"C\",\"pid\":%d,\"ts\":%.0f,\"name\":\"", (int)arm + 1, us);
+    events.push_back(buffer + jsonEscape(name) + "\",\"args\":{" + args + "}}");
+  }
+
+  void openSpan(Span &span, int track, double us, const std::string &name, const std::string &args = std::string())
+  {
+    closeSpan(span, track, us);
+    span.open = true;
+    span.startUs = us;
+    span.name = name;
+    span.args = args;
+  }
+
+  // Returns the span's duration, 0 if it wasn't open
+  double closeSpan(Span &span, int track, double us, const std::string &extraArgs = std::string())
+  {
+    if (!span.open)
+    {
+      return 0;
+    }
+    span.open = false;
+    std::string args = span.args;
+    if (!extraArgs.empty())
+    {
+      args += (args.empty() ? "" : ",") + extraArgs;
+    }
+    complete(track, span.startUs, us, span.name, args);
+    return us - span.startUs;
+  }
+
+  bool anyMoving() const
+  {
+    const ArmTimeline &a = arms[arm];
+    for (int i = 0; i < SERVO_COUNT; i++)
+    {
+      if (a.servoMoving[i])
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Time with at least one servo moving, so overlapping moves count once
+  void accumulateMoving(double us)
+  {
+    ArmTimeline &a = arms[arm];
+    if (a.inCycle && anyMoving())
+    {
+      a.current.movingUs += us - a.movingSinceUs;
+    }
+    a.movingSinceUs = us;
+  }
+
+  void handleMessage(const TelemetryMessage &m)
+  {
+    double us = unwrap(m.timeUs, m.event == EV_BOOT);
+    const uint8_t *p = m.payload;
+    char text[96];
+
+    if (m.event == EV_ARM)
+    {
+      if (m.payloadLength >= 1)
+      {
+        arm = p[0];
+        if (arm >= arms.size())
+        {
+          arms.resize(arm + 1);
+        }
+      }
+      return;
+    }
+    ArmTimeline &a = arms[arm];
+
+    switch (m.event)
+    {
+    case EV_BOOT:
+      finish();
+      instant(TRACK_CYCLE, us, "boot");
+      break;
+
+    case EV_TEXT:
+    {
+      std::string line(reinterpret_cast<const char *>(p), m.payloadLength);
+      instant(TRACK_LOG, us, line);
+      break;
+    }
+
+    case EV_DROPPED:
+      if (m.payloadLength >= 4)
+      {
+        std::snprintf(text, sizeof(text), "\"total\":%lu", (unsigned long)u32(p));
+        instant(TRACK_LOG, us, "frames dropped", text);
+      }
+      break;
+
+    case EV_CYCLE_START:
+      a.cycleCount++;
+      std::snprintf(text, sizeof(text), "cycle %lu", a.cycleCount);
+      openSpan(a.cycle, TRACK_CYCLE, us, text);
+      a.current = CycleStats();
+      a.current.startUs = us;
+      a.current.movingUs = a.current.dwellUs = a.current.senseUs = 0;
+      a.current.attempts = 0;
+      a.inCycle = true;
+      a.movingSinceUs = us;
+      break;
+
+    case EV_CYCLE_END:
+      closeSpan(a.step, TRACK_STEP, us);
+      if (a.inCycle)
+      {
+        accumulateMoving(us);
+        a.current.endUs = us;
+        a.current.result = m.payloadLength >= 1 ? colorOf(p[0]) : "?";
+        a.cycles.push_back(a.current);
+        a.inCycle = false;
+      }
+      std::snprintf(text, sizeof(text), "\"sorted\":\"%s\"", m.payloadLength >= 1 ? colorOf(p[0]) : "?");
+      closeSpan(a.cycle, TRACK_CYCLE, us, text);
+      break;
+
+    case EV_STEP:
+      if (m.payloadLength >= 2)
+      {
+        std::snprintf(text, sizeof(text), "%s %u", p[0] < 3 ? sequenceNames[p[0]] : "?", p[1]);
+        openSpan(a.step, TRACK_STEP, us, text);
+      }
+      break;
+
+    case EV_STATE:
+      // Parents are reported too; the track shows the innermost state
+      if (m.payloadLength >= 1 && p[0] < STATE_COUNT && p[0] != STATE_ACTIVE && p[0] != STATE_RETURN)
+      {
+        openSpan(a.state, TRACK_STATE, us, stateNames[p[0]]);
+      }
+      break;
+
+    case EV_MOVE_START:
+      if (m.payloadLength >= 4 && p[0] < SERVO_COUNT)
+      {
+        std::snprintf(text, sizeof(text), "%u -> %u", p[1], p[2]);
+        std::string args;
+        char buffer[64];
+        std::snprintf(buffer, sizeof(buffer), "\"from\":%u,\"to\":%u,\"ms_per_degree\":%u", p[1], p[2], p[3]);
+        args = buffer;
+        openSpan(a.moves[p[0]], TRACK_SERVO + p[0], us, text, args);
+        accumulateMoving(us);
+        a.servoMoving[p[0]] = true;
+      }
+      break;
+
+    case EV_MOVE_END:
+      if (m.payloadLength >= 2 && p[0] < SERVO_COUNT)
+      {
+        std::snprintf(text, sizeof(text), "\"reached\":%u", p[1]);
+        closeSpan(a.moves[p[0]], TRACK_SERVO + p[0], us, text);
+        accumulateMoving(us);
+        a.servoMoving[p[0]] = false;
+      }
+      break;
+
+    case EV_DWELL_START:
+      if (m.payloadLength >= 2)
+      {
+        std::snprintf(text, sizeof(text), "dwell %u ms", u16(p));
+        openSpan(a.dwell, TRACK_DWELL, us, text);
+      }
+      break;
+
+    case EV_DWELL_END:
+    {
+      double spent = closeSpan(a.dwell, TRACK_DWELL, us);
+      if (a.inCycle)
+      {
+        a.current.dwellUs += spent;
+      }
+      break;
+    }
+
+    case EV_ATTACH:
+    case EV_DETACH:
+      if (m.payloadLength >= 1 && p[0] < SERVO_COUNT)
+      {
+        instant(TRACK_SERVO + p[0], us, m.event == EV_ATTACH ? "attach" : "detach");
+      }
+      break;
+
+    case EV_SENSE_START:
+      openSpan(a.sense, TRACK_SENSE, us, "sense");
+      break;
+
+    case EV_SENSE_RESULT:
+      if (m.payloadLength >= 9)
+      {
+        std::snprintf(text, sizeof(text),
+                      "\"result\":\"%s\",\"color\":\"%s\",\"red\":%u,\"green\":%u,\"blue\":%u,\"scale\":%u",
+                      p[0] < 3 ? resultNames[p[0]] : "?", colorOf(p[1]), u16(p + 2), u16(p + 4), u16(p + 6), p[8]);
+        double spent = closeSpan(a.sense, TRACK_SENSE, us, text);
+        if (a.inCycle)
+        {
+          a.current.senseUs += spent;
+        }
+      }
+      break;
+
+    case EV_ATTEMPT:
+      if (m.payloadLength >= 2)
+      {
+        std::snprintf(text, sizeof(text), "attempt %u/%u", p[0], p[1]);
+        instant(TRACK_SENSE, us, text);
+        if (a.inCycle)
+        {
+          a.current.attempts = p[0];
+        }
+      }
+      break;
+
+    case EV_APPROACH_ABORT:
+      if (m.payloadLength >= 1)
+      {
+        std::snprintf(text, sizeof(text), "\"arm\":%u", p[0]);
+        instant(TRACK_SERVO + SERVO_ARM, us, "approach aborted", text);
+      }
+      break;
+
+    case EV_GRIP_CHECK:
+      if (m.payloadLength >= 4)
+      {
+        if (u16(p + 2) == 0xFFFF)
+        {
+          std::snprintf(text, sizeof(text), "\"grab\":%u,\"input\":\"feedback\"", p[1]);
+        }
+        else
+        {
+          std::snprintf(text, sizeof(text), "\"grab\":%u,\"clear\":%u", p[1], u16(p + 2));
+        }
+        instant(TRACK_SERVO + SERVO_GRABBER2, us, p[0] ? "grip held" : "grip missed", text);
+        a.gripChecks++;
+        if (p[0])
+        {
+          a.gripsHeld++;
+        }
+      }
+      break;
+
+    case EV_FEED_OBJECT:
+      if (m.payloadLength >= 4)
+      {
+        std::snprintf(text, sizeof(text), "\"color\":\"%s\",\"queued\":%u,\"arrives in ms\":%u",
+                      colorOf(p[0]), p[1], u16(p + 2));
+        instant(TRACK_SENSE, us, "feed object", text);
+      }
+      break;
+
+    case EV_STATS:
+      if (m.payloadLength >= 26)
+      {
+        char args[256];
+        std::snprintf(args, sizeof(args),
+                      "\"loop max ms\":%.1f,\"longest block ms\":%.1f,\"max motion gap ms\":%.1f,"
+                      "\"isr us/frame\":%u,\"stack used\":%u,\"min free ram\":%u",
+                      u32(p + 4) / 1000.0, u32(p + 12) / 1000.0, u32(p + 16) / 1000.0,
+                      u16(p + 20), u16(p + 22), u16(p + 24));
+        counter(us, "stats", args);
+      }
+      break;
+
+    default:
+      break; // Trace records and anything newer than this tool
+    }
+  }
+
+  std::vector<uint8_t> pending;
+  std::vector<std::string> events;
+  std::vector<ArmTimeline> arms;
+  size_t arm;
+  double offsetUs;
+  uint32_t lastRawUs;
+  double lastUs;
+  bool haveTime;
+  unsigned long frames;
+  unsigned long badFrames;
+};
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  unsigned long baud = 250000;
+  int arg = 1;
+  if (arg + 1 < argc && std::strcmp(argv[arg], "-b") == 0)
+  {
+    baud = std::strtoul(argv[arg + 1], 0, 10);
+    arg += 2;
+  }
+  if (arg >= argc)
+  {
+    std::fprintf(stderr, "usage: %s [-b baud] <serial-device|capture-file> [out.json]\n", argv[0]);
+    return 2;
+  }
+  const char *input = argv[arg];
+  const char *output = arg + 1 < argc ? argv[arg + 1] : "trace.json";
+
+  int fd = open(input, O_RDONLY | O_NOCTTY);
+  if (fd < 0)
+  {
+    std::perror(input);
+    return 1;
+  }
+  bool live = isatty(fd);
+  if (live)
+  {
+    if (!configureSerial(fd, baud))
+    {
+      std::perror("configuring serial port");
+      return 1;
+    }
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::fprintf(stderr, "reading %s at %lu baud, Ctrl-C to stop\n", input, baud);
+  }
+
+  TimelineBuilder builder;
+  uint8_t buffer[4096];
+  while (!stopRequested)
+  {
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n <= 0)
+    {
+      break; // End of file, error, or interrupted by Ctrl-C
+    }
+    builder.feed(buffer, (size_t)n);
+  }
+  close(fd);
+
+  builder.finish();
+  builder.printSummary();
+  return builder.writeJson(output) ? 0 : 1;
+}
@@ -0,0 +1,314 @@
+// Host-side replay of sensor traces recorded by the firmware's TraceRecorder.
+//
+// Feeds every recorded pick attempt through a detection policy and reports
+// how well it did against the operator's labels. Link it against whichever
+// classifier build you want to benchmark:
+//
+//   g++ -std=c++11 -O2 -Iinclude -o trace_replay
+//       tools/trace_replay/trace_replay.cpp src/Classifier.cpp
+//   ./trace_replay [-d dominant|lowest[:limit]] capture.bin [capture2.bin ...]
+//
+//   -d dominant        classifyColor(), the DominantColor policy (default)
+//   -d lowest[:limit]  classifyLowest(), the LowestBelow policy; limit
+//                      defaults to CLASSIFIER_LOWEST_LIMIT
+//
+// A capture is the raw telemetry stream from the serial port with
+// traceRecording enabled, e.g. saved with `cat /dev/ttyACM0 > capture.bin`.
+// Frames other than EV_TRACE are skipped.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "Classifier.h"
+#include "TelemetryFormat.h"
+#include "TraceFormat.h"
+
+namespace
+{
+
+const char *const colorNames[] = {"unknown", "red", "green", "blue", "none"};
+const int colorCount = 5;
+
+// Detection policy being replayed, as chosen with -d
+bool useLowest = false;
+uint16_t lowestLimit = CLASSIFIER_LOWEST_LIMIT;
+
+Color classify(const ColorReading &reading)
+{
+  return useLowest ? classifyLowest(reading, lowestLimit).color : classifyColor(reading).color;
+}
+
+// Parse the argument of -d
+bool parsePolicy(const char *text)
+{
+  if (std::strcmp(text, "dominant") == 0)
+  {
+    useLowest = false;
+    return true;
+  }
+  if (std::strncmp(text, "lowest", 6) != 0 || (text[6] != 0 && text[6] != ':'))
+  {
+    return false;
+  }
+  useLowest = true;
+  if (text[6] == ':')
+  {
+    char *end;
+    unsigned long limit = std::strtoul(text + 7, &end, 10);
+    if (end == text + 7 || *end != 0 || limit > 0xFFFF)
+    {
+      return false;
+    }
+    lowestLimit = (uint16_t)limit;
+  }
+  return true;
+}
+
+bool isDecision(Color color)
+{
+  return color == COLOR_RED || color == COLOR_GREEN || color == COLOR_BLUE;
+}
+
+bool loadTrace(const char *path, std::vector<TraceSample> &samples, unsigned long &rejected)
+{
+  FILE *file = std::fopen(path, "rb");
+  if (!file)
+  {
+    std::perror(path);
+    return false;
+  }
+
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+  {
+    data.insert(data.end(), chunk, chunk + n);
+  }
+  std::fclose(file);
+
+  // Split on the 0x00 frame delimiters
+  size_t frameStart = 0;
+  for (size_t i = 0; i < data.size(); i++)
+  {
+    if (data[i] != 0)
+    {
+      continue;
+    }
+
+    uint8_t message[TELEMETRY_MAX_FRAME];
+    size_t frameLength = i - frameStart;
+    size_t length = 0;
+    if (frameLength > 0 && frameLength <= TELEMETRY_MAX_FRAME)
+    {
+      length = cobsDecode(&data[frameStart], frameLength, message);
+    }
+    frameStart = i + 1;
+
+    TelemetryMessage parsed;
+    if (length == 0 || !parseTelemetryMessage(message, length, parsed))
+    {
+      rejected++;
+      continue;
+    }
+
+    TraceSample sample;
+    if (parsed.event == EV_TRACE)
+    {
+      if (parsed.payloadLength == TRACE_RECORD_SIZE && decodeTraceRecord(parsed.payload, sample))
+      {
+        samples.push_back(sample);
+      }
+      else
+      {
+        rejected++;
+      }
+    }
+  }
+  return true;
+}
+
+struct CycleResult
+{
+  Color label;
+  Color decision;
+  unsigned samplesUsed;
+  unsigned long timeToDecisionUs;
+};
+
+// Replay one pick attempt the way pickUpObject() does: keep reading until
+// the classifier commits to a color or the attempt runs out of samples.
+CycleResult replayCycle(const std::vector<TraceSample> &samples, size_t first, size_t end)
+{
+  CycleResult result;
+  result.label = samples[end - 1].label;
+  result.decision = COLOR_NONE;
+  result.samplesUsed = 0;
+  result.timeToDecisionUs = 0;
+
+  for (size_t i = first; i < end; i++)
+  {
+    const TraceSample &sample = samples[i];
+    result.samplesUsed++;
+    result.timeToDecisionUs = sample.startUs + sample.durationMs * 1000UL - samples[first].startUs;
+    if (sample.flags & TRACE_FLAG_TIMEOUT)
+    {
+      continue;
+    }
+
+    Color color = classify(sample.reading);
+    if (isDecision(color))
+    {
+      result.decision = color;
+      break;
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  int arg = 1;
+  bool usable = true;
+  if (arg + 1 < argc && std::strcmp(argv[arg], "-d") == 0)
+  {
+    usable = parsePolicy(argv[arg + 1]);
+    arg += 2;
+  }
+  if (!usable || arg >= argc)
+  {
+    std::fprintf(stderr, "usage: %s [-d dominant|lowest[:limit]] capture.bin [capture.bin ...]\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<TraceSample> samples;
+  unsigned long rejected = 0;
+  for (int i = arg; i < argc; i++)
+  {
+    if (!loadTrace(argv[i], samples, rejected))
+    {
+      return 1;
+    }
+  }
+  if (samples.empty())
+  {
+    std::fprintf(stderr, "no trace records found\n");
+    return 1;
+  }
+
+  // Split into pick attempts
+  std::vector<CycleResult> cycles;
+  size_t cycleStart = 0;
+  for (size_t i = 1; i <= samples.size(); i++)
+  {
+    if (i == samples.size() || (samples[i].flags & TRACE_FLAG_CYCLE_START))
+    {
+      cycles.push_back(replayCycle(samples, cycleStart, i));
+      cycleStart = i;
+    }
+  }
+
+  // Per-sample accuracy against the label, ignoring timeouts
+  unsigned long labelledSamples = 0;
+  unsigned long correctSamples = 0;
+  unsigned long timeouts = 0;
+  for (size_t i = 0; i < samples.size(); i++)
+  {
+    if (samples[i].flags & TRACE_FLAG_TIMEOUT)
+    {
+      timeouts++;
+      continue;
+    }
+    if (samples[i].label == COLOR_UNKNOWN)
+    {
+      continue;
+    }
+    Color color = classify(samples[i].reading);
+    labelledSamples++;
+    if (color == samples[i].label ||
+        (samples[i].label == COLOR_NONE && !isDecision(color)))
+    {
+      correctSamples++;
+    }
+  }
+
+  // Per-attempt accuracy, decision cost and confusion matrix
+  unsigned long labelledCycles = 0;
+  unsigned long correctCycles = 0;
+  unsigned long decisions = 0;
+  unsigned long decisionSamples = 0;
+  double decisionTimeUs = 0;
+  unsigned long confusion[colorCount][colorCount] = {};
+  for (size_t i = 0; i < cycles.size(); i++)
+  {
+    const CycleResult &cycle = cycles[i];
+    if (isDecision(cycle.decision))
+    {
+      decisions++;
+      decisionSamples += cycle.samplesUsed;
+      decisionTimeUs += cycle.timeToDecisionUs;
+    }
+    if (cycle.label == COLOR_UNKNOWN || cycle.label >= colorCount)
+    {
+      continue;
+    }
+    labelledCycles++;
+    confusion[cycle.label][cycle.decision < colorCount ? cycle.decision : COLOR_UNKNOWN]++;
+    if (cycle.decision == cycle.label)
+    {
+      correctCycles++;
+    }
+  }
+
+  if (useLowest)
+  {
+    std::printf("policy:             lowest below %u\n", lowestLimit);
+  }
+  else
+  {
+    std::printf("policy:             dominant channel\n");
+  }
+  std::printf("records:            %lu (%lu corrupt, %lu timeouts)\n",
+              (unsigned long)samples.size(), rejected, timeouts);
+  std::printf("pick attempts:      %lu (%lu labelled)\n",
+              (unsigned long)cycles.size(), labelledCycles);
+  if (labelledSamples > 0)
+  {
+    std::printf("sample accuracy:    %.1f%% (%lu/%lu)\n",
+                100.0 * correctSamples / labelledSamples, correctSamples, labelledSamples);
+  }
+  if (labelledCycles > 0)
+  {
+    std::printf("attempt accuracy:   %.1f%% (%lu/%lu)\n",
+                100.0 * correctCycles / labelledCycles, correctCycles, labelledCycles);
+  }
+  if (decisions > 0)
+  {
+    std::printf("samples/decision:   %.2f\n", (double)decisionSamples / decisions);
+    std::printf("time to decision:   %.1f ms\n", decisionTimeUs / decisions / 1000.0);
+  }
+
+  if (labelledCycles > 0)
+  {
+    std::printf("\nlabel \\ decision");
+    for (int d = 0; d < colorCount; d++)
+    {
+      std::printf("%9s", colorNames[d]);
+    }
+    std::printf("\n");
+    for (int l = 1; l < colorCount; l++)
+    {
+      std::printf("%-16s", colorNames[l]);
+      for (int d = 0; d < colorCount; d++)
+      {
+        std::printf("%9lu", confusion[l][d]);
+      }
+      std::printf("\n");
+    }
+  }
+  return 0;
+}